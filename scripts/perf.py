@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Runs mkt-bench over the presets and compares the results with a baseline.
+
+Every preset is run at several atom counts with a fixed seed. The results go to --output,
+a run slower than the baseline by more than the tolerance makes the script fail.
+Run with --update to store the results as the new baseline, along with the machine they
+were measured on. Timings only compare on that machine, a baseline of another one is reported.
+"""
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+
+PRESETS = [0, 1, 2]
+ATOMS = [10_000, 50_000, 100_000]
+
+
+def run(args, preset, atoms):
+    cmd = [args.bench, "--preset", str(preset), "--dim", str(args.dim), "--atoms", str(atoms),
+           "--steps", str(args.steps), "--seed", str(args.seed)]
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    return json.loads(out.strip().splitlines()[-1])
+
+
+def machine():
+    """CPU model, logical CPU count and OS of this machine."""
+    cpu = platform.processor() or platform.machine()
+    try:
+        with open("/proc/cpuinfo") as f:
+            for line in f:
+                if line.startswith("model name"):
+                    cpu = line.split(":", 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    return {"cpu": cpu, "cpus": os.cpu_count(), "platform": platform.platform()}
+
+
+def key(result):
+    return "{}/{}d/{}".format(result["preset"], result["dim"], result["atoms"])
+
+
+def compare(result, base, args):
+    """Returns the regressions of one scenario as strings."""
+    failures = []
+    if result["stepsPerSecond"] < base["stepsPerSecond"] * (1 - args.tolerance):
+        failures.append("steps/s {:.1f} < {:.1f}".format(result["stepsPerSecond"], base["stepsPerSecond"]))
+    if result["peakRssKiB"] > base["peakRssKiB"] * (1 + args.rss_tolerance):
+        failures.append("peak RSS {} KiB > {} KiB".format(result["peakRssKiB"], base["peakRssKiB"]))
+    for phase, seconds in result["phaseSeconds"].items():
+        limit = base["phaseSeconds"].get(phase)
+        # Phases of a few microseconds are all noise.
+        if limit is not None and seconds > 1e-5 and seconds > limit * (1 + args.phase_tolerance):
+            failures.append("{} {:.3g} s > {:.3g} s".format(phase, seconds, limit))
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--bench", default="build/src/bench/mkt-bench")
+    parser.add_argument("--baseline", default=os.path.join(os.path.dirname(__file__), "perf-baseline.json"))
+    parser.add_argument("--output", default="perf.json")
+    parser.add_argument("--atoms", default=",".join(map(str, ATOMS)), help="comma separated atom counts")
+    parser.add_argument("--dim", type=int, default=3)
+    parser.add_argument("--steps", type=int, default=200)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--tolerance", type=float, default=0.10, help="allowed steps/s drop")
+    parser.add_argument("--rss-tolerance", type=float, default=0.10, help="allowed peak RSS growth")
+    parser.add_argument("--phase-tolerance", type=float, default=0.25, help="allowed phase time growth")
+    parser.add_argument("--update", action="store_true", help="store the results as the baseline")
+    args = parser.parse_args()
+
+    results = {}
+    for preset in PRESETS:
+        for atoms in map(int, args.atoms.split(",")):
+            result = run(args, preset, atoms)
+            results[key(result)] = result
+            print("{:24} {:10.1f} steps/s {:8} KiB".format(key(result), result["stepsPerSecond"], result["peakRssKiB"]))
+
+    with open(args.output, "w") as f:
+        json.dump(results, f, indent=2)
+
+    if args.update:
+        with open(args.baseline, "w") as f:
+            json.dump({"machine": machine(), "results": results}, f, indent=2)
+        print("Baseline written to", args.baseline)
+        return 0
+
+    if not os.path.exists(args.baseline):
+        print("No baseline at {}, run with --update to create one".format(args.baseline))
+        return 1
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    if baseline.get("machine") != machine():
+        print("Baseline measured on {}, this is {}".format(baseline.get("machine"), machine()))
+
+    failed = False
+    for name, result in results.items():
+        if name not in baseline["results"]:
+            print("{}: not in the baseline".format(name))
+            continue
+        for failure in compare(result, baseline["results"][name], args):
+            print("{}: {}".format(name, failure))
+            failed = True
+    print("Regression" if failed else "No regressions")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
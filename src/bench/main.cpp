@@ -0,0 +1,77 @@
+#include "presets.hpp"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+
+// Peak resident set of the bench, KiB. Linux keeps ru_maxrss over exec, so it may be the peak
+// of the process that started the bench, VmHWM starts over.
+static long peakRssKiB() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stol(line.substr(6));
+        }
+    }
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Runs one preset without the GUI and prints its speed as one line of JSON.
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption presetOption("preset", "Preset: 0 axis, 1 random, 2 twoGases.", "preset", "1");
+    QCommandLineOption dimOption("dim", "Chamber dimension, 2 or 3.", "dim", "3");
+    QCommandLineOption atomsOption("atoms", "Atom count.", "atoms", "100000");
+    QCommandLineOption stepsOption("steps", "Measured steps.", "steps", "200");
+    QCommandLineOption warmupOption("warmup", "Steps run before measuring, they cover the cell size tuning.", "steps", "64");
+    QCommandLineOption seedOption("seed", "Seed of the atom placement.", "seed", "1");
+    parser.addOptions({presetOption, dimOption, atomsOption, stepsOption, warmupOption, seedOption});
+    parser.process(app);
+
+    const size_t presetIdx = parser.value(presetOption).toUInt();
+    const size_t dim = parser.value(dimOption).toUInt();
+    const size_t atoms = parser.value(atomsOption).toUInt();
+    const size_t steps = std::max(1u, parser.value(stepsOption).toUInt());
+    const size_t warmup = parser.value(warmupOption).toUInt();
+    const unsigned seed = parser.value(seedOption).toUInt();
+    if (presetIdx >= phys::PresetCount || (dim != 2 && dim != 3)) {
+        std::cerr << "Unknown preset or dimension\n";
+        return 1;
+    }
+    const auto preset = static_cast<phys::Preset>(presetIdx);
+
+    std::unique_ptr<phys::Chamber> chamber = phys::makePreset(preset, dim, atoms, seed);
+    for (size_t i = 0; i < warmup; ++i) {
+        chamber->step();
+    }
+
+    std::array<double, phys::StepPhases> phaseSeconds{};
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < steps; ++i) {
+        chamber->step();
+        for (size_t phase = 0; phase < phys::StepPhases; ++phase) {
+            phaseSeconds[phase] += chamber->getCounters().phaseSeconds[phase];
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "{\"preset\":\"" << phys::presetName(preset) << "\",\"dim\":" << dim << ",\"atoms\":" << atoms
+              << ",\"seed\":" << seed << ",\"steps\":" << steps << ",\"stepsPerSecond\":" << steps / elapsed.count()
+              << ",\"peakRssKiB\":" << peakRssKiB() << ",\"phaseSeconds\":{";
+    for (size_t phase = 0; phase < phys::StepPhases; ++phase) {
+        std::cout << (phase ? "," : "") << '"' << phys::phaseName(static_cast<phys::StepPhase>(phase)) << "\":"
+                  << phaseSeconds[phase] / steps;
+    }
+    std::cout << "}}\n";
+    return 0;
+}
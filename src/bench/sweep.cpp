@@ -0,0 +1,124 @@
+#include "ensemble.hpp"
+#include "physconstants.hpp"
+#include "presets.hpp"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <iostream>
+
+// Comma separated numbers, empty gives the single value fallback.
+static std::vector<phys::num_t> parseList(const QString& list, phys::num_t fallback) {
+    std::vector<phys::num_t> values;
+    for (const QString& item : list.split(',', Qt::SkipEmptyParts)) {
+        values.push_back(item.toDouble());
+    }
+    if (values.empty()) {
+        values.push_back(fallback);
+    }
+    return values;
+}
+
+// Runs a preset over a grid of X lengths, initial speeds and thermostat targets, every point
+// several times with different seeds, all of them at once. Prints one line of JSON per run.
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption presetOption("preset", "Preset: 0 axis, 1 random, 2 twoGases.", "preset", "1");
+    QCommandLineOption dimOption("dim", "Chamber dimension, 2 or 3.", "dim", "3");
+    QCommandLineOption atomsOption("atoms", "Atom count of every chamber.", "atoms", "10000");
+    QCommandLineOption stepsOption("steps", "Steps of every chamber.", "steps", "1000");
+    QCommandLineOption replicasOption("replicas", "Runs of every point, with seeds seed, seed + 1, ...", "replicas", "1");
+    QCommandLineOption seedOption("seed", "Seed of the first replica.", "seed", "1");
+    QCommandLineOption lengthsOption("lengths", "Factors of the X length, comma separated (pV sweep).", "factors", "1");
+    QCommandLineOption speedsOption("speeds", "Factors of the initial speeds, comma separated (pT sweep).", "factors", "1");
+    QCommandLineOption temperaturesOption("temperatures", "Thermostat targets, comma separated (pT sweep).", "kelvins");
+    QCommandLineOption thermostatOption("thermostat", "Thermostat of --temperatures: rescale or andersen.", "mode", "rescale");
+    QCommandLineOption rampOption("ramp", "Steps the thermostat moves the temperature to the target over.", "steps", "0");
+    parser.addOptions({presetOption, dimOption, atomsOption, stepsOption, replicasOption, seedOption, lengthsOption,
+                       speedsOption, temperaturesOption, thermostatOption, rampOption});
+    parser.process(app);
+
+    const size_t presetIdx = parser.value(presetOption).toUInt();
+    const size_t dim = parser.value(dimOption).toUInt();
+    const size_t atoms = parser.value(atomsOption).toUInt();
+    const size_t steps = std::max(1u, parser.value(stepsOption).toUInt());
+    const size_t replicas = std::max(1u, parser.value(replicasOption).toUInt());
+    const unsigned seed = parser.value(seedOption).toUInt();
+    const std::vector<phys::num_t> lengths = parseList(parser.value(lengthsOption), 1);
+    const std::vector<phys::num_t> speeds = parseList(parser.value(speedsOption), 1);
+    // 0 K runs without a thermostat.
+    const std::vector<phys::num_t> temperatures = parseList(parser.value(temperaturesOption), 0);
+    if (presetIdx >= phys::PresetCount || (dim != 2 && dim != 3)) {
+        std::cerr << "Unknown preset or dimension\n";
+        return 1;
+    }
+    const auto preset = static_cast<phys::Preset>(presetIdx);
+
+    phys::Thermostat thermostat;
+    thermostat.rampSteps = parser.value(rampOption).toUInt();
+    if (parser.value(thermostatOption) == "rescale") {
+        thermostat.mode = phys::ThermostatMode::Rescale;
+    } else if (parser.value(thermostatOption) == "andersen") {
+        thermostat.mode = phys::ThermostatMode::Andersen;
+    } else {
+        std::cerr << "Unknown thermostat\n";
+        return 1;
+    }
+
+    struct Point {
+        phys::num_t length;
+        phys::num_t speed;
+        phys::num_t temperature;
+        unsigned seed;
+    };
+    std::vector<Point> points;
+    std::vector<phys::EnsembleJob> jobs;
+    for (phys::num_t length : lengths) {
+        for (phys::num_t speed : speeds) {
+            for (phys::num_t temperature : temperatures) {
+                for (size_t replica = 0; replica < replicas; ++replica) {
+                    Point point{length, speed, temperature, static_cast<unsigned>(seed + replica)};
+                    points.push_back(point);
+                    jobs.push_back({[=] {
+                        auto chamber = phys::makePreset(preset, dim, atoms, point.seed, point.length, point.speed);
+                        // Pressure over the second half of the run, the first one settles the gas.
+                        chamber->setPressureWindow(phys::PresetStep * phys::num_t{std::max<size_t>(1, steps / 2)});
+                        if (point.temperature > phys::num_t{0}) {
+                            phys::Thermostat bath = thermostat;
+                            bath.temperature = phys::Temperature{point.temperature};
+                            bath.seed = point.seed;
+                            chamber->setThermostat(bath);
+                        }
+                        return chamber;
+                    }, steps});
+                }
+            }
+        }
+    }
+
+    std::vector<phys::EnsembleResult> results = phys::runEnsemble(jobs);
+    for (size_t idx = 0; idx < results.size(); ++idx) {
+        const phys::Chamber::Metrics& metrics = results[idx].metrics;
+        double pressure = 0;
+        double energy = 0;
+        for (size_t i = 0; i < 2 * dim; ++i) {
+            pressure += static_cast<double>(metrics.pressure[i]) / static_cast<double>(2 * dim);
+        }
+        for (size_t i = 0; i < dim; ++i) {
+            energy += static_cast<double>(*metrics.kineticEnergy[i]);
+        }
+        const double temperature =
+            metrics.nAtoms ? 2 * energy / (dim * metrics.nAtoms * static_cast<double>(*phys::consts::k)) : 0;
+
+        std::cout << "{\"preset\":\"" << phys::presetName(preset) << "\",\"dim\":" << dim << ",\"atoms\":" << metrics.nAtoms
+                  << ",\"steps\":" << steps << ",\"lengthScale\":" << static_cast<double>(points[idx].length)
+                  << ",\"speedScale\":" << static_cast<double>(points[idx].speed)
+                  << ",\"targetTemperature\":" << static_cast<double>(points[idx].temperature) << ",\"seed\":" << points[idx].seed
+                  << ",\"volume\":" << static_cast<double>(metrics.volume) << ",\"pressure\":" << pressure
+                  << ",\"temperature\":" << temperature << ",\"pV\":" << pressure * static_cast<double>(metrics.volume)
+                  << ",\"seconds\":" << results[idx].seconds << "}\n";
+    }
+    return 0;
+}
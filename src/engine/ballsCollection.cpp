@@ -1,125 +1,1120 @@
 #include "ballsCollection.hpp"
+#include "parallel.hpp"
+#include "physconstants.hpp"
+#include <numbers>
 #include <numeric>
 #include <iostream>
 #include <QtConcurrent/QtConcurrent>
 #include <QMutexLocker>
 
-static const auto StepSize = 16;
 namespace phys {
 
 static const num_t holeSize = 0.1;
 
-detail::GasAtomProxy::GasAtomProxy(BallsCollection& balls, size_t index) : m_balls(balls), m_index(index), m_atom(balls.getAtom(index)) {}
+// Reflections of one atom off the walls of one axis in a step.
+static const size_t MaxBounces = 4;
 
-void detail::GasAtomProxy::updateBalls() {
-    for(size_t i = 0; i < UniverseDim; ++i) {
-        m_balls.m_coords    [i][m_index] = *(m_atom.getPos()     [i] / m_balls.m_mScale);
-        m_balls.m_velocities[i][m_index] = *(m_atom.getVelocity()[i] / m_balls.m_mScale * m_balls.m_tScale);
-    }
+// Cells g(r) looks past the cell of an atom along every axis.
+static const int RdfReach = 2;
+
+// Stable pseudo-random key of an atom serial, used to pick render subsamples.
+static uint32_t sampleHash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
 }
 
-void BallsCollection::deleteAtom(size_t i) {
-    --m_nAtoms;
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
 
-    for(size_t j = 0; j < UniverseDim; ++j) {
-        std::swap(m_coords[j][i], m_coords[j][m_nAtoms]);
-        m_coords[j].pop_back();
+// Counter-based uniform in [0, 1): draw n of a key depends on nothing else, so the numbers of an
+// atom are the same however the atoms are split between threads.
+static double counterUniform(uint64_t key, uint64_t n) {
+    return static_cast<double>(mix64(key + n * 0x9e3779b97f4a7c15ULL) >> 11) * 0x1.0p-53;
+}
 
-        std::swap(m_velocities[j][i], m_velocities[j][m_nAtoms]);
-        m_velocities[j].pop_back();
-    }
+// Draws of an atom in a step: the collision test, then two per pair of velocity components.
+static const uint64_t BathDraws = 8;
 
-    std::swap(m_masses[i], m_masses[m_nAtoms]);
-    m_masses.pop_back();
+static uint16_t quantize(num_t x, num_t wall) {
+    num_t q = x / wall * num_t{RenderQuantMax};
+    if (q < num_t{0})
+        return 0;
+    if (q > num_t{RenderQuantMax})
+        return RenderQuantMax;
+    return static_cast<uint16_t>(q);
+}
+
+template <size_t Dim>
+detail::GasAtomProxy<Dim>::GasAtomProxy(BallsCollection<Dim>& balls, size_t index) : m_balls(balls), m_index(index), m_atom(balls.getAtom(index)) {}
 
-    std::swap(m_radiuses[i], m_radiuses[m_nAtoms]);
-    m_radiuses.pop_back();
+template <size_t Dim>
+void detail::GasAtomProxy<Dim>::updateBalls() {
+    for(size_t i = 0; i < Dim; ++i) {
+        m_balls.m_coords    [i][m_index] = *(m_atom.getPos()     [i] / m_balls.m_mScale);
+        m_balls.m_velocities[i][m_index] = *(m_atom.getVelocity()[i] / m_balls.m_mScale * m_balls.m_tScale);
+    }
 }
 
-GasAtom BallsCollection::getAtom(size_t i) const {
+template <size_t Dim>
+GasAtom<Dim> BallsCollection<Dim>::getAtom(size_t i) const {
     assert(i < m_nAtoms);
     Position pos;
     Velocity v;
-    for(size_t j = 0; j < UniverseDim; ++j) {
+    for(size_t j = 0; j < Dim; ++j) {
         pos[j] = m_mScale            * m_coords    [j][i];
         v  [j] = m_mScale / m_tScale * m_velocities[j][i];
     }
-    return GasAtom{pos, v, Mass{m_masses[i]}, m_mScale * m_radiuses[i]};
+    const Species& species = m_species[m_speciesIds[i]];
+    return GasAtom<Dim>{pos, v, species.mass, species.radius};
+}
+
+template <size_t Dim>
+Vector<Energy, Dim> BallsCollection<Dim>::getKineticDistributed() const {
+    std::array<std::array<num_t, Dim>, StepSize> partial = {};
+    parallelChunks(m_nAtoms, [this, &partial] (size_t chunk, size_t l, size_t r) {
+        for (size_t i = l; i < r; ++i) {
+            for (size_t d = 0; d < Dim; ++d) {
+                partial[chunk][d] += mass(i) * m_velocities[d][i] * m_velocities[d][i];
+            }
+        }
+    });
+
+    Vector<Energy, Dim> energy{};
+    const num_t scale = *(m_mScale / m_tScale) * *(m_mScale / m_tScale) / 2;
+    for (const auto& sums : partial) {
+        for (size_t d = 0; d < Dim; ++d) {
+            energy[d] += Energy{sums[d] * scale};
+        }
+    }
+    return energy;
+}
+
+template <size_t Dim>
+Impulse<Dim> BallsCollection<Dim>::getMomentum() const {
+    std::array<std::array<num_t, Dim>, StepSize> partial = {};
+    parallelChunks(m_nAtoms, [this, &partial] (size_t chunk, size_t l, size_t r) {
+        for (size_t i = l; i < r; ++i) {
+            for (size_t d = 0; d < Dim; ++d) {
+                partial[chunk][d] += mass(i) * m_velocities[d][i];
+            }
+        }
+    });
+
+    Impulse<Dim> momentum{};
+    for (const auto& sums : partial) {
+        for (size_t d = 0; d < Dim; ++d) {
+            momentum[d] += Mass{sums[d]} * (m_mScale / m_tScale);
+        }
+    }
+    return momentum;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::fillRenderBuffer(const RenderOptions& options, Column<RenderAtom>& buffer) const {
+    const bool sampled = options.sampleSize != 0 && options.sampleSize < m_nAtoms;
+    const uint64_t threshold = sampled ? (uint64_t{options.sampleSize} << 32) / m_nAtoms : 0;
+    // Keyed by serial, a compaction moves the drawn atoms but never swaps them for others.
+    auto isDrawn = [this, sampled, threshold] (size_t i) {
+        return !sampled || sampleHash(m_serials[i]) < threshold;
+    };
+
+    std::array<size_t, StepSize + 1> offsets = {};
+    if (sampled) {
+        parallelChunks(m_nAtoms, [&offsets, &isDrawn] (size_t chunk, size_t l, size_t r) {
+            for (size_t i = l; i < r; ++i) {
+                offsets[chunk + 1] += isDrawn(i);
+            }
+        }, "renderChunk");
+    } else {
+        const size_t chunkSize = std::max<size_t>(1, (m_nAtoms + StepSize - 1) / StepSize);
+        for (size_t chunk = 0; chunk < StepSize; ++chunk) {
+            offsets[chunk + 1] = std::min(m_nAtoms, (chunk + 1) * chunkSize) - std::min(m_nAtoms, chunk * chunkSize);
+        }
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    buffer.resize(offsets.back());
+
+    const num_t heatScale = *(m_mScale / m_tScale) * *(m_mScale / m_tScale) / 2 / *RenderHeatQuantum;
+    parallelChunks(m_nAtoms, [&] (size_t chunk, size_t l, size_t r) {
+        size_t out = offsets[chunk];
+        for (size_t i = l; i < r; ++i) {
+            if (!isDrawn(i))
+                continue;
+
+            RenderAtom& atom = buffer[out++];
+            atom.pos = {};
+            num_t v2 = 0;
+            for (size_t d = 0; d < Dim; ++d) {
+                atom.pos[d] = quantize(m_coords[d][i], m_walls[d]);
+                v2 += m_velocities[d][i] * m_velocities[d][i];
+            }
+            atom.radius = static_cast<uint8_t>(std::min(quantize(radius(i), m_walls[0]), uint16_t{0xff}));
+
+            if (options.key == RenderKey::Species) {
+                atom.color = m_speciesIds[i];
+            } else {
+                num_t key = mass(i) * v2 * heatScale;
+                atom.color = key < num_t{0xff} ? static_cast<uint8_t>(key) : 0xff;
+            }
+        }
+    }, "renderChunk");
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::fillField(const RenderOptions& options, Column<float>& field, Column<float>& counts) const {
+    const auto [width, height] = options.fieldSize;
+    const size_t nBins = width * height;
+    field.assign(nBins, 0.f);
+    counts.assign(nBins, 0.f);
+    if (nBins == 0 || options.field == FieldKind::None)
+        return;
+
+    auto& partial = m_fieldPartial;
+    const num_t energyScale = *(m_mScale / m_tScale) * *(m_mScale / m_tScale) / 2;
+    const num_t massSpan = m_maxMass > m_minMass ? m_maxMass - m_minMass : num_t{1};
+    parallelChunks(m_nAtoms, [&] (size_t chunk, size_t l, size_t r) {
+        auto& bins = partial[chunk];
+        bins.assign(nBins, {0.f, num_t{0}});
+        for (size_t i = l; i < r; ++i) {
+            size_t x = std::min<size_t>(width  - 1, static_cast<size_t>(std::max(num_t{0}, m_coords[0][i] / m_walls[0] * num_t{width})));
+            size_t y = std::min<size_t>(height - 1, static_cast<size_t>(std::max(num_t{0}, m_coords[1][i] / m_walls[1] * num_t{height})));
+            auto& bin = bins[y * width + x];
+            bin.first += 1.f;
+            if (options.field == FieldKind::Kinetic) {
+                num_t v2 = 0;
+                for (size_t d = 0; d < Dim; ++d) {
+                    v2 += m_velocities[d][i] * m_velocities[d][i];
+                }
+                bin.second += mass(i) * v2 * energyScale;
+            } else if (options.field == FieldKind::Species) {
+                bin.second += (mass(i) - m_minMass) / massSpan;
+            }
+        }
+    }, "renderChunk");
+
+    parallelChunks(nBins, [&] (size_t, size_t l, size_t r) {
+        for (size_t bin = l; bin < r; ++bin) {
+            float count = 0.f;
+            num_t sum = 0;
+            for (const auto& bins : partial) {
+                if (bins.empty())
+                    continue;
+                count += bins[bin].first;
+                sum   += bins[bin].second;
+            }
+            counts[bin] = count;
+            if (options.field == FieldKind::Density) {
+                field[bin] = count;
+            } else if (count > 0.f) {
+                field[bin] = static_cast<float>(sum / num_t{count});
+            }
+        }
+    }, "renderChunk");
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::placeColumns() {
+    forEachColumn([this] (auto& column, auto& scratch) {
+        firstTouch(column, m_nAtoms);
+        // Reserved untouched, the chunk workers of the first compaction write it first.
+        std::decay_t<decltype(scratch)>{}.swap(scratch);
+        scratch.reserve(m_nAtoms);
+    });
+    forEachCorrelatorColumn([this] (Column<num_t>& column) {
+        firstTouch(column, m_nAtoms);
+    });
+    firstTouch(m_escaped, m_nAtoms);
+    firstTouch(m_hashes, m_nAtoms);
+    firstTouch(m_indicies, m_nAtoms);
+    firstTouch(m_radixBuffer, m_nAtoms);
+    firstTouch(m_radixIndiciesBuffer, m_nAtoms);
+
+    // Overlapping pairs of a step stay well below the atom count in a gas.
+    m_collisionList.reserve(m_nAtoms);
+    m_placed = true;
 }
 
-void BallsCollection::move(Time dt) {
+template <size_t Dim>
+void BallsCollection<Dim>::move(Time dt) {
     num_t time = *(dt / m_tScale);
 
-    QFutureSynchronizer<void> synchronizer = {};
-    for(size_t d = 0; d < UniverseDim; ++d) {
-        for(size_t start = 0; start < m_nAtoms; start += m_nAtoms / StepSize) {
-            synchronizer.addFuture(QtConcurrent::run( 
-                [this, d, time, start] () {
-                    for(size_t i = start; i < std::min(m_nAtoms, start + m_nAtoms / StepSize); ++i) {
-                        m_coords[d][i] += m_velocities[d][i] * time;
+    if (!m_placed) {
+        placeColumns();
+    }
+
+    const bool sample = m_histogramPeriod != 0 && m_stepIdx % m_histogramPeriod == 0 && m_nAtoms != 0;
+    const num_t meanMass = sample ? m_massSum / num_t{m_nAtoms} : num_t{1};
+    if (sample) {
+        m_histogramBins = {};
+        m_histogramSampleRange = m_histogramRange;
+        m_histogramStep = m_stepIdx;
+    }
+
+    const uint32_t msdLevels = startMsdSample(time);
+    const uint32_t vacfLevels = startVacfSample(time);
+    const bool profile = m_profilePeriod != 0;
+    const bool sampleProfile = profile && startProfile();
+    const bool thermostat = startThermostat();
+
+    m_stepTime = time;
+    parallelChunks(m_nAtoms, [this, time, sample, meanMass, msdLevels, vacfLevels, profile, sampleProfile, thermostat] (size_t chunk, size_t l, size_t r) {
+        // Positions and velocities of the end of the last step.
+        if (msdLevels != 0) {
+            sampleMsd(chunk, l, r, msdLevels);
+        }
+        if (vacfLevels != 0) {
+            sampleVacf(chunk, l, r, vacfLevels);
+        }
+        if (thermostat) {
+            thermostatChunk(chunk, l, r);
+        }
+        double speed2 = 0;
+        for(size_t d = 0; d < Dim; ++d) {
+            double maxSpeed = 0;
+            for(size_t i = l; i < r; ++i) {
+                m_coords[d][i] += m_velocities[d][i] * time;
+                maxSpeed = std::max(maxSpeed, std::abs(static_cast<double>(m_velocities[d][i])));
+            }
+            speed2 += maxSpeed * maxSpeed;
+        }
+        m_chunkSweep[chunk].speed2 = speed2;
+        if (sample) {
+            sampleHistogram(chunk, l, r, meanMass);
+        }
+        if (profile) {
+            profileChunk(chunk, l, r, time, sampleProfile);
+        }
+    });
+
+    double speed2 = 0;
+    for (const auto& chunk : m_chunkSweep) {
+        speed2 = std::max(speed2, chunk.speed2);
+    }
+    m_maxSweep = time * std::sqrt(speed2) * 2;
+
+    if (msdLevels != 0) {
+        finishMsdSample(msdLevels);
+    }
+    if (vacfLevels != 0) {
+        finishVacfSample(vacfLevels);
+    }
+    if (profile) {
+        finishProfile(time, sampleProfile);
+    }
+    if (thermostat) {
+        finishThermostat();
+    }
+
+    if (sample) {
+        num_t u2 = 0;
+        size_t count = 0;
+        for (const auto& bins : m_histogramBins) {
+            u2 += bins.u2;
+            count += bins.count;
+        }
+        // Three rms speeds leave out a negligible Maxwell tail.
+        m_histogramRange = std::sqrt(u2 / num_t{count}) * num_t{3};
+    }
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::sampleHistogram(size_t chunk, size_t l, size_t r, num_t meanMass) {
+    HistogramBins& bins = m_histogramBins[chunk];
+    const num_t range = m_histogramSampleRange;
+    const num_t nBins = num_t{VelocityHistogram::Bins};
+
+    for (size_t i = l; i < r; ++i) {
+        const num_t reduce = std::sqrt(mass(i) / meanMass);
+        num_t u2 = 0;
+        for (size_t d = 0; d < Dim; ++d) {
+            num_t u = m_velocities[d][i] * reduce;
+            u2 += u * u;
+            num_t bin = (u + range) / (range * num_t{2}) * nBins;
+            if (range > num_t{0} && bin >= num_t{0} && bin < nBins) {
+                bins.axis[d][static_cast<size_t>(bin)]++;
+            }
+        }
+        num_t bin = std::sqrt(u2) / range * nBins;
+        if (range > num_t{0} && bin < nBins) {
+            bins.speed[static_cast<size_t>(bin)]++;
+        }
+        bins.u2 += u2;
+        bins.count++;
+    }
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::setMsdPeriod(size_t period) {
+    m_msdPeriod = period;
+    m_msd = MsdStats{};
+    m_msdStepTime = 0;
+    if (period != 0) {
+        restartMsd();
+        return;
+    }
+    for (size_t d = 0; d < Dim; ++d) {
+        Column<num_t>{}.swap(m_unwrap[d]);
+        if (m_vacfPeriod == 0) {
+            Column<num_t>{}.swap(m_unwrapSign[d]);
+        }
+    }
+    for (auto& level : m_msdOrigin) {
+        for (auto& origin : level) {
+            for (auto& column : origin) {
+                Column<num_t>{}.swap(column);
+            }
+        }
+    }
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::restartMsd() {
+    // The signs stay while they cover every atom, the VACF origins may be unfolded with them.
+    for (size_t d = 0; d < Dim; ++d) {
+        m_unwrap[d].assign(m_nAtoms, 0);
+        if (m_unwrapSign[d].size() != m_nAtoms) {
+            m_unwrapSign[d].assign(m_nAtoms, 1);
+        }
+    }
+    for (auto& level : m_msdOrigin) {
+        for (auto& origin : level) {
+            for (auto& column : origin) {
+                column.resize(m_nAtoms);
+            }
+        }
+    }
+    m_msdWindows.restart();
+}
+
+template <size_t Dim>
+uint32_t BallsCollection<Dim>::startMsdSample(num_t time) {
+    if (m_msdPeriod == 0 || m_stepIdx % m_msdPeriod != 0 || m_nAtoms == 0)
+        return 0;
+
+    // Lags are counted in steps of one dt.
+    if (time != m_msdStepTime) {
+        m_msd = MsdStats{};
+        m_msdStepTime = time;
+        restartMsd();
+    }
+    if (m_unwrap[0].size() != m_nAtoms) {
+        restartMsd();
+    }
+
+    const size_t sums = MsdStats::Levels * MsdStats::Lags * m_species.size() * Dim;
+    for (auto& chunk : m_chunkMsd) {
+        chunk.sums.assign(sums, 0);
+    }
+    return m_msdWindows.levels();
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::sampleMsd(size_t chunk, size_t l, size_t r, uint32_t levels) {
+    Column<num_t>& sums = m_chunkMsd[chunk].sums;
+    const size_t nSpecies = m_species.size();
+
+    for (size_t level = 0; level < MsdStats::Levels; ++level) {
+        if (!(levels & (1u << level)))
+            continue;
+        const size_t origins = m_msdWindows.origins(level);
+
+        for (size_t d = 0; d < Dim; ++d) {
+            for (size_t lag = 0; lag < origins; ++lag) {
+                const Column<num_t>& origin = m_msdOrigin[level][m_msdWindows.slot(level, lag)][d];
+                num_t* lagSums = sums.data() + (level * MsdStats::Lags + lag) * nSpecies * Dim + d;
+                for (size_t i = l; i < r; ++i) {
+                    const num_t dx = unfolded(d, i) - origin[i];
+                    lagSums[m_speciesIds[i] * Dim] += dx * dx;
+                }
+            }
+            // The oldest origin was read above, the sample takes its slot.
+            Column<num_t>& next = m_msdOrigin[level][m_msdWindows.nextSlot(level)][d];
+            for (size_t i = l; i < r; ++i) {
+                next[i] = unfolded(d, i);
+            }
+        }
+    }
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::finishMsdSample(uint32_t levels) {
+    const size_t nSpecies = m_species.size();
+    m_msd.species.resize(nSpecies);
+
+    for (size_t level = 0; level < MsdStats::Levels; ++level) {
+        if (!(levels & (1u << level)))
+            continue;
+
+        for (size_t lag = 0; lag < m_msdWindows.origins(level); ++lag) {
+            const size_t row = (level * MsdStats::Lags + lag) * nSpecies;
+            for (size_t id = 0; id < nSpecies; ++id) {
+                auto& series = m_msd.species[id];
+                for (const auto& chunk : m_chunkMsd) {
+                    for (size_t d = 0; d < Dim; ++d) {
+                        series.sum[level][lag][d] += chunk.sums[(row + id) * Dim + d];
                     }
                 }
-            ));
+                series.count[level][lag] += m_speciesCount[id];
+            }
         }
     }
-    synchronizer.waitForFinished();
+    m_msdWindows.advance(levels);
 }
 
-void BallsCollection::handleWallCollisions() {
+template <size_t Dim>
+void BallsCollection<Dim>::getMsd(MsdStats& stats) const {
+    stats = m_msd;
+    stats.dim = Dim;
+    stats.sampleTime = m_tScale * m_msdStepTime * num_t{m_msdPeriod};
 
-    for(size_t i = 0; i < 2*UniverseDim; ++i)
-        m_wallImpulse[(m_stepIdx / MeasurementSize) & (MeasurementSize - 1)][i] = 0;
+    const num_t area = *(m_mScale * m_mScale);
+    for (auto& series : stats.species) {
+        for (auto& level : series.sum) {
+            for (auto& lag : level) {
+                for (auto& axis : lag) {
+                    axis *= area;
+                }
+            }
+        }
+    }
+
+    // Periodic crossings and wall reflections are both unfolded, every axis diffuses freely.
+    stats.free = {};
+    std::fill(stats.free.begin(), stats.free.begin() + Dim, true);
+    fitDiffusion(stats);
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::setVacfPeriod(size_t period) {
+    m_vacfPeriod = period;
+    m_vacf = VacfStats{};
+    m_vacfStepTime = 0;
+    if (period != 0) {
+        restartVacf();
+        return;
+    }
+    for (auto& level : m_vacfOrigin) {
+        for (auto& origin : level) {
+            for (auto& column : origin) {
+                Column<num_t>{}.swap(column);
+            }
+        }
+    }
+    if (m_msdPeriod == 0) {
+        for (auto& column : m_unwrapSign) {
+            Column<num_t>{}.swap(column);
+        }
+    }
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::restartVacf() {
+    for (auto& column : m_unwrapSign) {
+        if (column.size() != m_nAtoms) {
+            column.assign(m_nAtoms, 1);
+        }
+    }
+    for (auto& level : m_vacfOrigin) {
+        for (auto& origin : level) {
+            for (auto& column : origin) {
+                column.resize(m_nAtoms);
+            }
+        }
+    }
+    m_vacfWindows.restart();
+}
+
+template <size_t Dim>
+uint32_t BallsCollection<Dim>::startVacfSample(num_t time) {
+    if (m_vacfPeriod == 0 || m_stepIdx % m_vacfPeriod != 0 || m_nAtoms == 0)
+        return 0;
+
+    if (time != m_vacfStepTime) {
+        m_vacf = VacfStats{};
+        m_vacfStepTime = time;
+        restartVacf();
+    }
+    if (m_vacfOrigin[0][0][0].size() != m_nAtoms) {
+        restartVacf();
+    }
+
+    // The last row of every chunk takes v^2 of the sample.
+    const size_t sums = (VacfStats::Levels * VacfStats::Lags + 1) * m_species.size();
+    for (auto& chunk : m_chunkVacf) {
+        chunk.sums.assign(sums, 0);
+    }
+    return m_vacfWindows.levels();
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::sampleVacf(size_t chunk, size_t l, size_t r, uint32_t levels) {
+    Column<num_t>& sums = m_chunkVacf[chunk].sums;
+    const size_t nSpecies = m_species.size();
+
+    num_t* zeroSums = sums.data() + VacfStats::Levels * VacfStats::Lags * nSpecies;
+    for (size_t d = 0; d < Dim; ++d) {
+        for (size_t i = l; i < r; ++i) {
+            zeroSums[m_speciesIds[i]] += m_velocities[d][i] * m_velocities[d][i];
+        }
+    }
+
+    for (size_t level = 0; level < VacfStats::Levels; ++level) {
+        if (!(levels & (1u << level)))
+            continue;
+        const size_t origins = m_vacfWindows.origins(level);
+
+        for (size_t d = 0; d < Dim; ++d) {
+            for (size_t lag = 0; lag < origins; ++lag) {
+                const Column<num_t>& origin = m_vacfOrigin[level][m_vacfWindows.slot(level, lag)][d];
+                num_t* lagSums = sums.data() + (level * VacfStats::Lags + lag) * nSpecies;
+                for (size_t i = l; i < r; ++i) {
+                    lagSums[m_speciesIds[i]] += origin[i] * m_unwrapSign[d][i] * m_velocities[d][i];
+                }
+            }
+            Column<num_t>& next = m_vacfOrigin[level][m_vacfWindows.nextSlot(level)][d];
+            for (size_t i = l; i < r; ++i) {
+                next[i] = m_unwrapSign[d][i] * m_velocities[d][i];
+            }
+        }
+    }
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::finishVacfSample(uint32_t levels) {
+    const size_t nSpecies = m_species.size();
+    m_vacf.species.resize(nSpecies);
+
+    for (size_t id = 0; id < nSpecies; ++id) {
+        auto& series = m_vacf.species[id];
+        for (const auto& chunk : m_chunkVacf) {
+            series.zero += chunk.sums[VacfStats::Levels * VacfStats::Lags * nSpecies + id];
+        }
+        series.zeroCount += m_speciesCount[id];
+    }
+
+    for (size_t level = 0; level < VacfStats::Levels; ++level) {
+        if (!(levels & (1u << level)))
+            continue;
+
+        for (size_t lag = 0; lag < m_vacfWindows.origins(level); ++lag) {
+            const size_t row = (level * VacfStats::Lags + lag) * nSpecies;
+            for (size_t id = 0; id < nSpecies; ++id) {
+                auto& series = m_vacf.species[id];
+                for (const auto& chunk : m_chunkVacf) {
+                    series.sum[level][lag] += chunk.sums[row + id];
+                }
+                series.count[level][lag] += m_speciesCount[id];
+            }
+        }
+    }
+    m_vacfWindows.advance(levels);
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::getVacf(VacfStats& stats) const {
+    stats = m_vacf;
+    stats.dim = Dim;
+    stats.sampleTime = m_tScale * m_vacfStepTime * num_t{m_vacfPeriod};
+
+    const num_t velocity2 = *(m_mScale / m_tScale) * *(m_mScale / m_tScale);
+    for (auto& series : stats.species) {
+        series.zero *= velocity2;
+        for (auto& level : series.sum) {
+            for (auto& lag : level) {
+                lag *= velocity2;
+            }
+        }
+    }
+    integrateGreenKubo(stats);
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::setProfilePeriod(size_t period) {
+    m_profilePeriod = period;
+    m_profile = ConcentrationProfile{};
+    m_profileTime = 0;
+    m_profileSampleTime = 0;
+    m_profileSampled = false;
+    m_sampleCrossed.clear();
+    m_fickFlux.clear();
+    m_fickGradient2.clear();
+}
+
+template <size_t Dim>
+bool BallsCollection<Dim>::startProfile() {
+    const size_t nSpecies = m_species.size();
+    const bool sample = m_stepIdx % m_profilePeriod == 0;
+    for (auto& chunk : m_chunkProfile) {
+        chunk.crossed.assign(nSpecies, 0);
+        if (sample) {
+            chunk.slabs.assign(nSpecies * ConcentrationProfile::Slabs, 0);
+        }
+    }
+    return sample;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::profileChunk(size_t chunk, size_t l, size_t r, num_t time, bool sample) {
+    ChunkProfile& bins = m_chunkProfile[chunk];
+    const double dt = static_cast<double>(time);
+    const double mid = static_cast<double>(m_walls[0]) / 2;
+    const double slabScale = ConcentrationProfile::Slabs / static_cast<double>(m_walls[0]);
+
+    for (size_t i = l; i < r; ++i) {
+        const double x = static_cast<double>(m_coords[0][i]);
+        const double before = x - static_cast<double>(m_velocities[0][i]) * dt;
+        const SpeciesId id = m_speciesIds[i];
+        // +1 from the low side to the high one, -1 back.
+        bins.crossed[id] += static_cast<int>(before < mid) - static_cast<int>(x < mid);
+        if (sample) {
+            const size_t slab = std::min(static_cast<size_t>(std::max(x * slabScale, 0.)), ConcentrationProfile::Slabs - 1);
+            bins.slabs[id * ConcentrationProfile::Slabs + slab]++;
+        }
+    }
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::finishProfile(num_t time, bool sample) {
+    const size_t nSpecies = m_species.size();
+    m_profile.atoms.resize(nSpecies);
+    m_profile.crossed.resize(nSpecies, 0);
+    m_profile.gradient.resize(nSpecies, 0);
+    m_profile.diffusion.resize(nSpecies, 0);
+    m_sampleCrossed.resize(nSpecies, 0);
+    m_fickFlux.resize(nSpecies, 0);
+    m_fickGradient2.resize(nSpecies, 0);
+
+    m_profileTime += time;
+    for (const auto& chunk : m_chunkProfile) {
+        for (size_t id = 0; id < chunk.crossed.size(); ++id) {
+            m_profile.crossed[id] += chunk.crossed[id];
+        }
+    }
+    if (!sample)
+        return;
+
+    const size_t Slabs = ConcentrationProfile::Slabs;
+    m_profile.step = m_stepIdx;
+    for (size_t id = 0; id < nSpecies; ++id) {
+        m_profile.atoms[id].fill(0);
+        for (const auto& chunk : m_chunkProfile) {
+            for (size_t slab = 0; slab < Slabs; ++slab) {
+                m_profile.atoms[id][slab] += chunk.slabs[id * Slabs + slab];
+            }
+        }
+    }
+
+    // Everything below is in SI units.
+    const num_t meter = *m_mScale;
+    num_t area = 1; // of the mid-plane
+    for (size_t d = 1; d < Dim; ++d) {
+        area *= m_walls[d] * meter;
+    }
+    const num_t width = m_walls[0] * meter / num_t{Slabs};
+    const num_t interval = (m_profileTime - m_profileSampleTime) * *m_tScale;
+
+    for (size_t id = 0; id < nSpecies; ++id) {
+        // Least squares slope of the density over the middle half of the slabs.
+        num_t n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (size_t slab = Slabs / 4; slab < Slabs * 3 / 4; ++slab) {
+            const num_t x = width * (num_t{slab} + num_t{0.5});
+            const num_t density = num_t{m_profile.atoms[id][slab]} / (area * width);
+            n += 1;
+            sx += x;
+            sy += density;
+            sxx += x * x;
+            sxy += x * density;
+        }
+        const num_t gradient = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+
+        if (m_profileSampled && interval > num_t{0}) {
+            const num_t flux = num_t{m_profile.crossed[id] - m_sampleCrossed[id]} / (area * interval);
+            const num_t meanGradient = (gradient + m_profile.gradient[id]) / num_t{2};
+            m_fickFlux[id] += flux * meanGradient;
+            m_fickGradient2[id] += meanGradient * meanGradient;
+            if (m_fickGradient2[id] > num_t{0}) {
+                m_profile.diffusion[id] = -m_fickFlux[id] / m_fickGradient2[id];
+            }
+        }
+        m_profile.gradient[id] = gradient;
+        m_sampleCrossed[id] = m_profile.crossed[id];
+    }
+    m_profileSampleTime = m_profileTime;
+    m_profileSampled = true;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::getProfile(ConcentrationProfile& profile) const {
+    profile = m_profile;
+    profile.dim = Dim;
+    profile.time = m_tScale * m_profileTime;
+    profile.slabWidth = m_mScale * m_walls[0] / num_t{ConcentrationProfile::Slabs};
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::setThermostat(const Thermostat& thermostat) {
+    // The heat stays: the invariant monitor counts it since the start.
+    m_thermostat = thermostat;
+    m_thermostatStats.mode = thermostat.mode;
+    m_thermostatStep = 0;
+    m_thermostatMeasured = 0;
+    m_thermostatScale = 1;
+}
 
-    QMutex deleteProtector = {};
-    std::vector<size_t> deleteCandidates = {};
+template <size_t Dim>
+bool BallsCollection<Dim>::startThermostat() {
+    if (m_thermostat.mode == ThermostatMode::Off || m_nAtoms == 0)
+        return false;
 
-    auto isInHole = [this] (size_t atomIdx) {
+    // Only the first step and the ones after atoms were added take a pass of their own.
+    if (m_thermostatMeasured == num_t{0}) {
+        m_thermostatMeasured = *(Trace(getKineticDistributed()) * num_t{2. / Dim} / num_t{m_nAtoms} / consts::k);
+    }
+    if (m_thermostatStep == 0) {
+        m_thermostatStart = m_thermostatMeasured;
+    }
+    const num_t target = *m_thermostat.target(Temperature{m_thermostatStart}, m_thermostatStep);
+    m_thermostatStats.target = Temperature{target};
+    m_chunkThermostat = {};
+
+    if (m_thermostat.mode == ThermostatMode::Rescale) {
+        // Berendsen: scale^2 = 1 + (T0 / T - 1) / tau, tau of one step rescales to T0 exactly.
+        const num_t relax = num_t{std::max<size_t>(1, m_thermostat.relaxSteps)};
+        const num_t scale2 = num_t{1} + (target / m_thermostatMeasured - num_t{1}) / relax;
+        m_thermostatScale = m_thermostatMeasured > num_t{0} && scale2 > num_t{0} ? std::sqrt(scale2) : num_t{1};
+    } else {
+        const num_t vScale = *(m_mScale / m_tScale);
+        m_bathSigma.resize(m_species.size());
+        for (size_t id = 0; id < m_species.size(); ++id) {
+            m_bathSigma[id] = std::sqrt(*consts::k * target / m_speciesMass[id]) / vScale;
+        }
+    }
+    return true;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::thermostatChunk(size_t chunk, size_t l, size_t r) {
+    ChunkThermostat& sums = m_chunkThermostat[chunk];
+    if (m_thermostat.mode == ThermostatMode::Rescale) {
+        const num_t scale = m_thermostatScale;
+        for (size_t d = 0; d < Dim; ++d) {
+            for (size_t i = l; i < r; ++i) {
+                m_velocities[d][i] *= scale;
+            }
+        }
+    } else {
+        const uint64_t key = mix64(m_thermostat.seed ^ mix64(m_stepIdx));
+        const double rate = static_cast<double>(m_thermostat.collisionRate);
+        for (size_t i = l; i < r; ++i) {
+            if (counterUniform(key, i * BathDraws) >= rate)
+                continue;
+
+            const double sigma = static_cast<double>(m_bathSigma[m_speciesIds[i]]);
+            double before = 0;
+            double after = 0;
+            for (size_t d = 0; d < Dim; d += 2) {
+                // Box-Muller, two normal components from two uniforms.
+                const double radius = sigma * std::sqrt(-2 * std::log(1 - counterUniform(key, i * BathDraws + d + 1)));
+                const double angle = 2 * std::numbers::pi * counterUniform(key, i * BathDraws + d + 2);
+                for (size_t c = d; c < std::min(d + 2, Dim); ++c) {
+                    const double v = static_cast<double>(m_velocities[c][i]);
+                    const double u = radius * (c == d ? std::cos(angle) : std::sin(angle));
+                    before += v * v;
+                    after += u * u;
+                    m_velocities[c][i] = u;
+                }
+            }
+            sums.heat += static_cast<double>(mass(i)) * (after - before);
+            sums.collisions++;
+        }
+    }
+
+    double energy = 0;
+    for (size_t i = l; i < r; ++i) {
+        double v2 = 0;
+        for (size_t d = 0; d < Dim; ++d) {
+            const double v = static_cast<double>(m_velocities[d][i]);
+            v2 += v * v;
+        }
+        energy += static_cast<double>(mass(i)) * v2;
+    }
+    sums.energy = energy;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::finishThermostat() {
+    double energy = 0;
+    double heat = 0;
+    for (const auto& chunk : m_chunkThermostat) {
+        energy += chunk.energy;
+        heat += chunk.heat;
+        m_thermostatStats.collisions += chunk.collisions;
+    }
+    if (m_thermostat.mode == ThermostatMode::Rescale) {
+        // The atoms had energy / scale^2 before the rescale.
+        const double scale = static_cast<double>(m_thermostatScale);
+        heat = energy * (1 - 1 / (scale * scale));
+    }
+
+    const double vScale = static_cast<double>(*(m_mScale / m_tScale));
+    const double k = static_cast<double>(*consts::k);
+    m_thermostatStats.heat += Energy{num_t{heat * vScale * vScale / 2}};
+    m_thermostatMeasured = num_t{energy * vScale * vScale / (Dim * static_cast<double>(m_nAtoms) * k)};
+    m_thermostatStats.temperature = Temperature{m_thermostatMeasured};
+    m_thermostatStep++;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::getVelocityHistogram(VelocityHistogram& hist) const {
+    hist = {};
+    hist.dim = Dim;
+    num_t u2 = 0;
+    for (const auto& bins : m_histogramBins) {
+        for (size_t b = 0; b < VelocityHistogram::Bins; ++b) {
+            hist.speed[b] += bins.speed[b];
+            for (size_t d = 0; d < Dim; ++d) {
+                hist.axis[d][b] += bins.axis[d][b];
+            }
+        }
+        u2 += bins.u2;
+        hist.count += bins.count;
+    }
+    if (hist.count == 0)
+        return;
+
+    hist.step = m_histogramStep;
+    hist.range = m_histogramSampleRange * m_mScale / m_tScale;
+
+    const num_t meanMass = m_massSum / num_t{m_nAtoms};
+    const num_t dispersion = u2 / num_t{hist.count} / num_t{Dim};
+    const VelocityVal sigma = std::sqrt(dispersion) * m_mScale / m_tScale;
+    hist.temperature = Mass{meanMass} * sigma * sigma / consts::k;
+    fitMaxwell(hist, sigma);
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::setMeasurementWindow(size_t slots, size_t stepsPerSlot) {
+    slots = std::max<size_t>(1, slots);
+    m_stepsPerSlot = std::max<size_t>(1, stepsPerSlot);
+    m_wallImpulse.assign(slots, WallImpulses{});
+    m_slotSteps.assign(slots, 0);
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::handleWallCollisions() {
+    const size_t slot = (m_stepIdx / m_stepsPerSlot) % m_wallImpulse.size();
+    if (m_stepIdx % m_stepsPerSlot == 0) {
+        m_wallImpulse[slot].fill(0);
+        m_slotSteps[slot] = 0;
+    }
+
+    // Looks where the atom crossed the wall plane, time before the end of the step.
+    auto isInHole = [this] (size_t atomIdx, num_t time) {
         if(!m_enableHole)
             return false;
         bool flag = true;
         
-        for (size_t holeDim = 1; holeDim < UniverseDim; holeDim++) {
-            if ((std::abs(m_coords[holeDim][atomIdx] - (m_walls[holeDim] / 2)) / m_walls[holeDim]) > holeSize) {
+        for (size_t holeDim = 1; holeDim < Dim; holeDim++) {
+            num_t crossing = m_coords[holeDim][atomIdx] + m_velocities[holeDim][atomIdx] * time;
+            if ((std::abs(crossing - (m_walls[holeDim] / 2)) / m_walls[holeDim]) > holeSize) {
                 flag = false;
             }
         }
 
         return flag;
     };
-    
-    QFutureSynchronizer<void> synchronizer = {};
-
-    for (size_t j = 0; j < UniverseDim; ++j) {
-        for(size_t start = 0; start < m_nAtoms; start += m_nAtoms / StepSize) {
-            synchronizer.addFuture(QtConcurrent::run(
-                [this, start, j, isInHole, &deleteProtector, &deleteCandidates] () {
-                    for(size_t i = start; i < std::min(m_nAtoms, start + m_nAtoms / StepSize); ++i) {
-                        if (m_coords[j][i] < m_radiuses[i]) {
-                            if ((j == 0) && isInHole(i)) {
-                                std::lock_guard guard{deleteProtector};
-                                deleteCandidates.push_back(i);
-                            }
-
-                            m_coords[j][i] = (m_radiuses[i] * 2) - m_coords[j][i];
-                            m_velocities[j][i] = -m_velocities[j][i];
-                            m_wallImpulse[(m_stepIdx / MeasurementSize) & (MeasurementSize-1)][2 * j] += m_masses[i] * m_velocities[j][i] * 2;
-                        } else if (m_coords[j][i] + m_radiuses[i] > m_walls[j]) {
-                            m_coords[j][i] = ((m_walls[j] - m_radiuses[i]) * 2) - m_coords[j][i];
-                            m_velocities[j][i] = -m_velocities[j][i];
-                            m_wallImpulse[(m_stepIdx / MeasurementSize) & (MeasurementSize-1)][2 * j + 1] += m_masses[i] * m_velocities[j][i] * 2;
+
+    for (auto& effusion : m_chunkEffusion) {
+        effusion.count = 0;
+    }
+    m_deleted = 0;
+    m_chunkImpulse = {};
+    parallelChunks(m_nAtoms, [this, isInHole] (size_t chunk, size_t l, size_t r) {
+        WallImpulses impulse = {};
+        for (size_t j = 0; j < Dim; ++j) {
+            if (m_boundaries[j] == Boundary::Periodic) {
+                const bool unwrap = m_unwrap[j].size() == m_nAtoms;
+                for(size_t i = l; i < r; ++i) {
+                    if (m_coords[j][i] < num_t{0}) {
+                        m_coords[j][i] += m_walls[j];
+                        if (unwrap) {
+                            m_unwrap[j][i] -= m_unwrapSign[j][i] * m_walls[j];
+                        }
+                    } else if (!(m_coords[j][i] < m_walls[j])) {
+                        m_coords[j][i] -= m_walls[j];
+                        if (unwrap) {
+                            m_unwrap[j][i] += m_unwrapSign[j][i] * m_walls[j];
+                        }
+                    }
+                }
+                continue;
+            }
+
+            // x' = mirror - x keeps the unfolded position if its sign flips and the offset takes sign * mirror.
+            const bool unwrap = m_unwrap[j].size() == m_nAtoms;
+            const bool mirrored = m_unwrapSign[j].size() == m_nAtoms;
+            auto unfold = [this, j, unwrap, mirrored] (size_t i, num_t mirror) {
+                if (unwrap) {
+                    m_unwrap[j][i] += m_unwrapSign[j][i] * mirror;
+                }
+                if (mirrored) {
+                    m_unwrapSign[j][i] = -m_unwrapSign[j][i];
+                }
+            };
+            for(size_t i = l; i < r; ++i) {
+                const num_t r_i = radius(i);
+                // Mirroring is exact for any speed, a flight longer than the chamber bounces again.
+                for (size_t bounce = 0; bounce < MaxBounces; ++bounce) {
+                    if (m_coords[j][i] < r_i) {
+                        if ((j == 0) && bounce == 0 && isInHole(i, (r_i - m_coords[j][i]) / m_velocities[j][i])) {
+                            m_escaped[i] = 1;
+                            countEscaped(chunk, i);
                         }
+
+                        m_coords[j][i] = (r_i * 2) - m_coords[j][i];
+                        m_velocities[j][i] = -m_velocities[j][i];
+                        unfold(i, r_i * 2);
+                        impulse[2 * j] += mass(i) * m_velocities[j][i] * 2;
+                    } else if (m_coords[j][i] + r_i > m_walls[j]) {
+                        m_coords[j][i] = ((m_walls[j] - r_i) * 2) - m_coords[j][i];
+                        m_velocities[j][i] = -m_velocities[j][i];
+                        unfold(i, (m_walls[j] - r_i) * 2);
+                        impulse[2 * j + 1] += mass(i) * m_velocities[j][i] * 2;
+                    } else {
+                        break;
                     }
                 }
-            ));
+            }
+        }
+        m_chunkImpulse[chunk].impulse = impulse;
+    });
+
+    for (const auto& chunk : m_chunkImpulse) {
+        for (size_t wall = 0; wall < 2 * Dim; ++wall) {
+            m_wallImpulse[slot][wall] += chunk.impulse[wall];
         }
     }
+    m_slotSteps[slot]++;
 
-    synchronizer.waitForFinished();
+    compactEscaped();
+    m_stepIdx++;
+}
 
-    for (auto& candidateIdx : deleteCandidates) {
-        deleteAtom(candidateIdx);
+template <size_t Dim>
+void BallsCollection<Dim>::countEscaped(size_t chunk, size_t i) {
+    ChunkEffusion& effusion = m_chunkEffusion[chunk];
+    if (effusion.count++ == 0) {
+        effusion.energy = 0;
+        effusion.byEnergy.fill(0);
+        effusion.bySpecies.assign(m_species.size(), 0);
     }
-    m_stepIdx++;
+
+    num_t mv2 = 0;
+    for (size_t d = 0; d < Dim; ++d) {
+        mv2 += mass(i) * m_velocities[d][i] * m_velocities[d][i];
+    }
+    effusion.energy += mv2;
+
+    size_t bin = EffusionStats::EnergyBins - 1;
+    if (m_effusionBinWidth > num_t{0} && mv2 / m_effusionBinWidth < num_t{bin}) {
+        bin = static_cast<size_t>(mv2 / m_effusionBinWidth);
+    }
+    effusion.byEnergy[bin]++;
+
+    effusion.bySpecies[m_speciesIds[i]]++;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::compactEscaped() {
+    TraceScope scope("compactEscaped");
+    size_t escaped = 0;
+    for (const auto& effusion : m_chunkEffusion) {
+        escaped += effusion.count;
+    }
+    if (escaped == 0)
+        return;
+
+    // Survivors of chunk k go to [offsets[k], offsets[k + 1]), chunks split like in parallelChunks.
+    std::array<size_t, StepSize + 1> offsets = {};
+    const size_t chunkSize = std::max<size_t>(1, (m_nAtoms + StepSize - 1) / StepSize);
+    for (size_t chunk = 0; chunk < StepSize; ++chunk) {
+        offsets[chunk + 1] = std::min(m_nAtoms, (chunk + 1) * chunkSize) - std::min(m_nAtoms, chunk * chunkSize) -
+                             m_chunkEffusion[chunk].count;
+    }
+
+    const num_t energyScale = *(m_mScale / m_tScale) * *(m_mScale / m_tScale) / 2;
+    for (const auto& effusion : m_chunkEffusion) {
+        if (effusion.count == 0)
+            continue;
+        m_effusion.total += effusion.count;
+        m_effusion.energy += Energy{effusion.energy * energyScale};
+        for (size_t bin = 0; bin < EffusionStats::EnergyBins; ++bin) {
+            m_effusion.byEnergy[bin] += effusion.byEnergy[bin];
+        }
+        m_effusion.bySpecies.resize(m_species.size(), 0);
+        for (size_t id = 0; id < effusion.bySpecies.size(); ++id) {
+            m_effusion.bySpecies[id] += effusion.bySpecies[id];
+            m_speciesCount[id] -= effusion.bySpecies[id];
+            m_massSum -= m_speciesMass[id] * num_t{effusion.bySpecies[id]};
+        }
+    }
+
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    const size_t kept = offsets.back();
+
+    forEachColumn([this] (auto&, auto& scratch) {
+        scratch.resize(m_nAtoms);
+    });
+
+    // One pass moves every column of a chunk to its place in the scratch columns.
+    parallelChunks(m_nAtoms, [this, &offsets] (size_t chunk, size_t l, size_t r) {
+        forEachColumn([this, &offsets, chunk, l, r] (auto& column, auto& scratch) {
+            size_t out = offsets[chunk];
+            for (size_t i = l; i < r; ++i) {
+                if (!m_escaped[i]) {
+                    scratch[out++] = column[i];
+                }
+            }
+        });
+    });
+
+    forEachColumn([kept] (auto& column, auto& scratch) {
+        column.swap(scratch);
+        column.resize(kept);
+    });
+
+    // The MSD and VACF origins are too many for scratch copies. Survivors only move down, so
+    // each column is compacted in place by one task.
+    std::array<Column<num_t>*, CorrelatorColumns> correlators = {};
+    size_t nCorrelators = 0;
+    forEachCorrelatorColumn([&correlators, &nCorrelators] (Column<num_t>& column) {
+        correlators[nCorrelators++] = &column;
+    });
+    parallelChunks(nCorrelators, [this, &correlators, kept] (size_t, size_t l, size_t r) {
+        for (size_t c = l; c < r; ++c) {
+            Column<num_t>& column = *correlators[c];
+            size_t out = 0;
+            for (size_t i = 0; i < m_nAtoms; ++i) {
+                if (!m_escaped[i]) {
+                    column[out++] = column[i];
+                }
+            }
+            column.resize(kept);
+        }
+    });
+    m_escaped.assign(kept, 0);
+    m_deleted = m_nAtoms - kept;
+    m_nAtoms = kept;
 }
 
 static uint32_t getShift(uint32_t x) {
@@ -133,81 +1128,485 @@ static uint32_t getShift(uint32_t x) {
     return shift;
 }
 
-void BallsCollection::setEnableHole(bool newEnableHole)
+template <size_t Dim>
+void BallsCollection<Dim>::setEnableHole(bool newEnableHole)
 {
     m_enableHole = newEnableHole;
+
+    if (m_enableHole && m_effusionBinWidth == num_t{0} && m_nAtoms != 0) {
+        // Bins span eight mean kinetic energies of the gas at the first opening.
+        const num_t energyScale = *(m_mScale / m_tScale) * *(m_mScale / m_tScale) / 2;
+        const num_t meanEnergy = *Trace(getKineticDistributed()) / num_t{m_nAtoms};
+        m_effusionBinWidth = meanEnergy / energyScale * num_t{8} / num_t{EffusionStats::EnergyBins};
+        m_effusion.binWidth = Energy{meanEnergy * num_t{8} / num_t{EffusionStats::EnergyBins}};
+    }
+}
+
+template <size_t Dim>
+SpeciesId BallsCollection<Dim>::addSpecies(Mass mass, Length radius) {
+    for (size_t id = 0; id < m_species.size(); ++id) {
+        if (m_species[id].mass == mass && m_species[id].radius == radius)
+            return static_cast<SpeciesId>(id);
+    }
+    assert(m_species.size() < MaxSpecies);
+
+    m_species.push_back({mass, radius});
+    m_speciesCount.push_back(0);
+    m_speciesMass.push_back(*mass);
+    m_speciesRadius.push_back(*(radius / m_mScale));
+    m_minMass = std::min(m_minMass, *mass);
+    m_maxMass = std::max(m_maxMass, *mass);
+    m_maxRadius = std::max(m_maxRadius, m_speciesRadius.back());
+
+    const size_t n = m_species.size();
+    m_pairContact2.resize(n * n);
+    m_pairReducedMass.resize(n * n);
+    for (size_t a = 0; a < n; ++a) {
+        for (size_t b = 0; b < n; ++b) {
+            num_t contact = m_speciesRadius[a] + m_speciesRadius[b];
+            m_pairContact2[a * n + b] = contact * contact;
+            m_pairReducedMass[a * n + b] = m_speciesMass[a] * m_speciesMass[b] / (m_speciesMass[a] + m_speciesMass[b]);
+        }
+    }
+    return static_cast<SpeciesId>(n - 1);
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::getSpeciesMetrics(std::vector<SpeciesMetrics>& metrics) const {
+    const size_t nSpecies = m_species.size();
+    for (auto& partial : m_speciesPartial) {
+        partial.assign(nSpecies, {0, num_t{0}});
+    }
+    parallelChunks(m_nAtoms, [this] (size_t chunk, size_t l, size_t r) {
+        auto& partial = m_speciesPartial[chunk];
+        for (size_t i = l; i < r; ++i) {
+            num_t v2 = 0;
+            for (size_t d = 0; d < Dim; ++d) {
+                v2 += m_velocities[d][i] * m_velocities[d][i];
+            }
+            auto& [count, mv2] = partial[m_speciesIds[i]];
+            count++;
+            mv2 += mass(i) * v2;
+        }
+    });
+
+    num_t volume = 1;
+    for (size_t d = 0; d < Dim; ++d) {
+        volume *= *(m_mScale * m_walls[d]);
+    }
+    const num_t energyScale = *(m_mScale / m_tScale) * *(m_mScale / m_tScale) / 2;
+
+    metrics.resize(nSpecies);
+    for (size_t id = 0; id < nSpecies; ++id) {
+        SpeciesMetrics& species = metrics[id];
+        species = {m_species[id]};
+
+        num_t mv2 = 0;
+        for (const auto& partial : m_speciesPartial) {
+            species.count += partial[id].first;
+            mv2 += partial[id].second;
+        }
+        if (species.count == 0)
+            continue;
+
+        Energy energy{mv2 * energyScale};
+        species.temperature = energy * num_t{2} / num_t{Dim * species.count} / consts::k;
+        species.pressure = *energy * num_t{2} / (num_t{Dim} * volume);
+    }
 }
 
-void BallsCollection::setCellSize(Length l) {
+template <size_t Dim>
+bool BallsCollection<Dim>::resolveCollision(size_t i, size_t j) {
+    const size_t pair = m_speciesIds[i] * m_species.size() + m_speciesIds[j];
+
+    num_t time = 0;
+    if (!sweptContact(i, j, time))
+        return false;
+
+    std::array<num_t, Dim> axis; // from i to j at the contact
+    num_t dist2 = 0;
+    for (size_t d = 0; d < Dim; ++d) {
+        axis[d] = separation(d, j, i) + (m_velocities[d][j] - m_velocities[d][i]) * time;
+        dist2 += axis[d] * axis[d];
+    }
+    if (!(dist2 > num_t{0}))
+        return false;
+
+    const num_t dist = std::sqrt(dist2);
+    num_t approach = 0;
+    for (size_t d = 0; d < Dim; ++d) {
+        axis[d] /= dist;
+        approach += (m_velocities[d][i] - m_velocities[d][j]) * axis[d];
+    }
+    if (approach < num_t{0})
+        return false;
+
+    // Normal velocities change by 2 mu / m of the approach speed.
+    const num_t dvi = m_pairReducedMass[pair] * 2 / mass(i) * approach;
+    const num_t dvj = m_pairReducedMass[pair] * 2 / mass(j) * approach;
+    // The atoms leave the contact point with the new velocities for the rest of the step.
+    for (size_t d = 0; d < Dim; ++d) {
+        m_velocities[d][i] -= dvi * axis[d];
+        m_velocities[d][j] += dvj * axis[d];
+        m_coords[d][i] += dvi * axis[d] * time;
+        m_coords[d][j] -= dvj * axis[d] * time;
+    }
+    return true;
+}
+
+template <size_t Dim>
+bool BallsCollection<Dim>::sweptContact(size_t i, size_t j, num_t& time) const {
+    // |dp + dv t|^2 = contact^2 for t in [-dt, 0], positions are of the end of the step.
+    // Plain doubles: this is the inner loop of the broad phase, epsilon comparisons cost too much.
+    double a = 0, b = 0;
+    double c = -static_cast<double>(m_pairContact2[m_speciesIds[i] * m_species.size() + m_speciesIds[j]]);
+    for (size_t d = 0; d < Dim; ++d) {
+        const double dp = static_cast<double>(separation(d, j, i));
+        const double dv = static_cast<double>(m_velocities[d][j] - m_velocities[d][i]);
+        a += dv * dv;
+        b += dp * dv * 2;
+        c += dp * dp;
+    }
+
+    const bool overlap = c < 0;
+    // Approaching or resting pairs were farther apart before, a pass needs them parting now.
+    if (!overlap && (!m_continuous || b <= 0))
+        return false;
+    const double discriminant = b * b - a * c * 4;
+    if (a <= 0 || discriminant < 0) {
+        time = 0;
+        return overlap;
+    }
+
+    const double dt = static_cast<double>(m_stepTime);
+    const double contact = (-b - std::sqrt(discriminant)) / (a * 2);
+    if (contact < -dt) {
+        time = -dt;
+        return overlap;
+    }
+    time = contact;
+    return contact < 0 || overlap;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::setCellSize(Length l) {
     num_t len = *(l / m_mScale);
     m_cellSize = len;
 
-    m_shifts[0] = 0;
-    std::cerr << "Grid dim: ";
-    for(size_t i = 1; i < UniverseDim; ++i) {
-        uint32_t nCells = std::ceil((m_walls[i-1] / len).getVal());
-        std::cerr << nCells << '*';
-        m_shifts[i] =  m_shifts[i-1] + getShift(nCells);
-    }
-    uint32_t nCells = std::ceil((m_walls[UniverseDim-1] / len).getVal());
-    std::cerr << nCells << '\n';
-    assert(m_shifts.back() + getShift(nCells) < 32);
-}
-
-
-void BallsCollection::handleCollisions() {
-// Counting hashes;
-    QFutureSynchronizer<void> syncher = {};
-    for (size_t start = 0; start < m_nAtoms; start += m_nAtoms / StepSize) {
-        syncher.addFuture(QtConcurrent::run(
-            [start, this] () {
-                for (size_t i = start; i < std::min(m_nAtoms, start + m_nAtoms / StepSize); i++) {
-                    m_indicies[i] = static_cast<uint32_t>(i);
-                }
+    for(size_t i = 0; i < Dim; ++i) {
+        if (m_boundaries[i] == Boundary::Periodic) {
+            // Fewer than three cells would make the stencil meet the same neighbour twice.
+            m_cellCounts[i] = std::floor((m_walls[i] / len).getVal());
+            if (m_cellCounts[i] < 3) {
+                m_cellCounts[i] = 1;
             }
-        ));
+            m_cellSizes[i] = m_walls[i] / num_t{m_cellCounts[i]};
+        } else {
+            m_cellCounts[i] = std::ceil((m_walls[i] / len).getVal());
+            m_cellSizes[i] = len;
+        }
+    }
 
-        syncher.addFuture(QtConcurrent::run(
-            [start, this] () {
-                for (size_t i = start; i < std::min(m_nAtoms, start + m_nAtoms / StepSize); i++) {
-                    m_hashes[i] = 0;
-                    for(size_t j = 0; j < UniverseDim; ++j) {
-                        m_hashes[i] |= static_cast<uint32_t>(m_coords[j][i] / m_cellSize) << m_shifts[j];
-                    }
-                }
-            }
-        ));
+    m_shifts[0] = 0;
+    for(size_t i = 1; i < Dim; ++i) {
+        m_shifts[i] =  m_shifts[i-1] + getShift(m_cellCounts[i-1]);
+    }
+    assert(m_shifts.back() + getShift(m_cellCounts.back()) < 32);
+}
+
+template <size_t Dim>
+Length BallsCollection<Dim>::getMinCellSize() const {
+    const num_t gridCells = 1u << (31 / Dim);
+    const num_t maxWall = *std::max_element(m_walls.begin(), m_walls.end());
+    const num_t sweep = m_continuous ? m_maxSweep : num_t{0};
+    return m_mScale * std::max(m_maxRadius * 2 + sweep, maxWall / gridCells);
+}
+
+template <size_t Dim>
+CellOccupancy BallsCollection<Dim>::getOccupancy() const {
+    CellOccupancy occupancy;
+    for (const auto& chunk : m_chunkPairs) {
+        occupancy.cells += chunk.cells;
+        occupancy.max = std::max(occupancy.max, chunk.maxAtoms);
+    }
+    if (occupancy.cells != 0) {
+        occupancy.mean = num_t{m_hashedAtoms} / num_t{occupancy.cells};
+    }
+    occupancy.cellSize = getCellSize();
+    return occupancy;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::setBoundary(size_t axis, Boundary boundary) {
+    m_boundaries[axis] = boundary;
+    if (m_cellSize > num_t{0}) {
+        setCellSize(m_mScale * m_cellSize);
     }
-    syncher.waitForFinished();
+}
+
+template <size_t Dim>
+Position<Dim> BallsCollection<Dim>::getSeparation(size_t i, size_t j) const {
+    Position pos;
+    for (size_t d = 0; d < Dim; ++d) {
+        pos[d] = m_mScale * separation(d, i, j);
+    }
+    return pos;
+}
+
+
+template <size_t Dim>
+void BallsCollection<Dim>::handleCollisions() {
+    parallelChunks(m_nAtoms, [this] (size_t, size_t l, size_t r) {
+        for (size_t i = l; i < r; i++) {
+            m_indicies[i] = static_cast<uint32_t>(i);
+            m_hashes[i] = 0;
+            for(size_t j = 0; j < Dim; ++j) {
+                m_hashes[i] |= cellOf(j, i) << m_shifts[j];
+            }
+        }
+    });
+    m_hashedAtoms = m_nAtoms;
 
     radixSort();
 
-    m_radixBuffer.assign(m_nAtoms, 0);
-    
     m_collisionList.clear();
 
-    QFutureSynchronizer<void> synchronizer = {};
+    // A chunk takes the cells starting in it, the last of them may reach into the next chunk.
+    m_chunkPairs = {};
+    parallelChunks(m_nAtoms, [this] (size_t chunk, size_t l, size_t r) {
+        size_t tested = 0;
+        size_t cells = 0;
+        size_t maxAtoms = 0;
+        for (size_t i = l; i < r; ++i) {
+            if (i != 0 && m_hashes[i] == m_hashes[i - 1])
+                continue;
+            size_t end = i + 1;
+            while (end < m_nAtoms && m_hashes[end] == m_hashes[i]) {
+                ++end;
+            }
+            tested += handleCell(i, end);
+            cells++;
+            maxAtoms = std::max(maxAtoms, end - i);
+        }
+        m_chunkPairs[chunk] = {tested, cells, maxAtoms};
+    });
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::auditBroadPhase(std::minstd_rand& random, BroadPhaseAudit& audit) {
+    if (m_nAtoms < 2)
+        return;
+
+    const double share = std::min(1., std::pow(static_cast<double>(AuditAtoms) / m_nAtoms, 1. / Dim));
+    std::uniform_real_distribution<double> uniform(0., 1. - share);
+    std::array<num_t, Dim> lo, hi;
+    for (size_t d = 0; d < Dim; ++d) {
+        lo[d] = m_walls[d] * num_t{uniform(random)};
+        hi[d] = lo[d] + m_walls[d] * num_t{share};
+    }
+
+    m_auditAtoms.clear();
+    for (size_t i = 0; i < m_nAtoms; ++i) {
+        bool inside = true;
+        for (size_t d = 0; d < Dim; ++d) {
+            inside &= !(m_coords[d][i] < lo[d]) && m_coords[d][i] < hi[d];
+        }
+        if (inside) {
+            m_auditAtoms.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    m_auditPairs.clear();
+    for (auto [i, j] : m_collisionList) {
+        m_auditPairs.emplace_back(static_cast<uint32_t>(std::min(i, j)), static_cast<uint32_t>(std::max(i, j)));
+    }
+    std::sort(m_auditPairs.begin(), m_auditPairs.end());
+
+    for (size_t a = 0; a < m_auditAtoms.size(); ++a) {
+        for (size_t b = a + 1; b < m_auditAtoms.size(); ++b) {
+            const uint32_t i = m_auditAtoms[a];
+            const uint32_t j = m_auditAtoms[b];
+            num_t time;
+            if (!sweptContact(i, j, time))
+                continue;
+            audit.overlaps++;
+            if (!std::binary_search(m_auditPairs.begin(), m_auditPairs.end(), std::make_pair(i, j))) {
+                audit.missed++;
+            }
+        }
+    }
+    audit.windows++;
+}
+
+// Offsets of the cells up to reach cells away whose first nonzero component is positive,
+// so every pair of these cells is looked at once.
+template <size_t Dim>
+static const std::vector<std::array<int, Dim>>& halfStencil(int reach = 1) {
+    static const auto stencils = [] {
+        std::array<std::vector<std::array<int, Dim>>, RdfReach + 1> all;
+        for (int r = 1; r <= RdfReach; ++r) {
+            const size_t width = static_cast<size_t>(2 * r + 1);
+            size_t codes = 1;
+            for (size_t d = 0; d < Dim; ++d) {
+                codes *= width;
+            }
+            for (size_t code = 0; code < codes; ++code) {
+                std::array<int, Dim> offset;
+                for (size_t d = 0, rest = code; d < Dim; ++d, rest /= width) {
+                    offset[d] = static_cast<int>(rest % width) - r;
+                }
+                auto first = std::find_if(offset.begin(), offset.end(), [] (int x) { return x != 0; });
+                if (first != offset.end() && *first > 0) {
+                    all[r].push_back(offset);
+                }
+            }
+        }
+        return all;
+    }();
+    return stencils[reach];
+}
 
-    for(size_t i = 0; i < m_nAtoms; i += m_nAtoms / StepSize) {
-        synchronizer.addFuture(QtConcurrent::run(&BallsCollection::handleSub, this, i, std::min(i + m_nAtoms / StepSize, m_nAtoms)));
+template <size_t Dim>
+bool BallsCollection<Dim>::neighbourCell(size_t atom, const std::array<int, Dim>& offset, uint32_t& hash) const {
+    hash = 0;
+    for (size_t d = 0; d < Dim; ++d) {
+        int64_t cell = static_cast<int64_t>(cellOf(d, atom)) + offset[d];
+        const int64_t count = m_cellCounts[d];
+        if (m_boundaries[d] == Boundary::Periodic && count > 1) {
+            cell = (cell + count) % count;
+        }
+        if (cell < 0 || cell >= count)
+            return false;
+        hash |= static_cast<uint32_t>(cell) << m_shifts[d];
     }
-    synchronizer.waitForFinished();
+    return true;
 }
 
-void BallsCollection::handleSub(size_t l, size_t r) {
-    size_t prev = l;
-    for(size_t i = l+1; i < r; ++i) {
-        if (m_hashes[i] != m_hashes[prev]) {
-            if(i > prev + 1) {
-                handleBlock(prev, i);
+template <size_t Dim>
+void BallsCollection<Dim>::sampleRdf() {
+    if (m_hashedAtoms != m_nAtoms || m_nAtoms < 2)
+        return;
+
+    // A periodic axis needs 2 reach + 1 cells, or the stencil meets the same cell twice.
+    int reach = RdfReach;
+    num_t cell = m_cellSizes[0];
+    num_t volume = 1;
+    for (size_t d = 0; d < Dim; ++d) {
+        cell = std::min(cell, m_cellSizes[d]);
+        volume *= m_walls[d];
+        if (m_boundaries[d] == Boundary::Periodic) {
+            reach = std::min(reach, (static_cast<int>(m_cellCounts[d]) - 1) / 2);
+        }
+    }
+    if (reach < 1)
+        return;
+
+    // Bins stay put while the grid grows, a finer grid starts the distribution over.
+    const num_t range = cell * num_t{reach};
+    if (m_rdfRange == num_t{0} || range < m_rdfRange) {
+        m_rdf = PairDistribution{};
+        m_rdfRange = range;
+    }
+
+    const double range2 = static_cast<double>(m_rdfRange * m_rdfRange);
+    const double binScale = PairDistribution::Bins / static_cast<double>(m_rdfRange);
+    const auto& stencil = halfStencil<Dim>(reach);
+    m_chunkRdf = {};
+    parallelChunks(m_nAtoms, [this, range2, binScale, &stencil] (size_t chunk, size_t l, size_t r) {
+        auto& pairs = m_chunkRdf[chunk].pairs;
+        auto count = [this, range2, binScale, &pairs] (size_t i, size_t j) {
+            double dist2 = 0;
+            for (size_t d = 0; d < Dim; ++d) {
+                const double dx = static_cast<double>(separation(d, i, j));
+                dist2 += dx * dx;
+            }
+            if (dist2 < range2) {
+                pairs[std::min(static_cast<size_t>(std::sqrt(dist2) * binScale), PairDistribution::Bins - 1)]++;
+            }
+        };
+
+        // Cells starting in the chunk, like in handleCollisions().
+        for (size_t i = l; i < r; ++i) {
+            if (i != 0 && m_hashes[i] == m_hashes[i - 1])
+                continue;
+            size_t end = i + 1;
+            while (end < m_nAtoms && m_hashes[end] == m_hashes[i]) {
+                ++end;
+            }
+            for (size_t idx = i; idx < end; ++idx) {
+                for (size_t jdx = idx + 1; jdx < end; ++jdx) {
+                    count(m_indicies[idx], m_indicies[jdx]);
+                }
+            }
+
+            for (const auto& offset : stencil) {
+                uint32_t hash;
+                if (!neighbourCell(m_indicies[i], offset, hash))
+                    continue;
+                auto [first, last] = std::equal_range(m_hashes.begin(), m_hashes.begin() + m_nAtoms, hash);
+                for (auto it = first; it != last; ++it) {
+                    const size_t j = m_indicies[it - m_hashes.begin()];
+                    for (size_t idx = i; idx < end; ++idx) {
+                        count(m_indicies[idx], j);
+                    }
+                }
             }
-            prev = i;
+        }
+    });
+
+    for (const auto& chunk : m_chunkRdf) {
+        for (size_t bin = 0; bin < PairDistribution::Bins; ++bin) {
+            m_rdf.pairs[bin] += chunk.pairs[bin];
         }
     }
+    num_t rangeVolume = 1;
+    for (size_t d = 0; d < Dim; ++d) {
+        rangeVolume *= m_rdfRange;
+    }
+    const num_t n = num_t{m_nAtoms};
+    m_rdf.ideal += n * (n - num_t{1}) / num_t{2} / volume * rangeVolume;
+    m_rdf.samples++;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::resetRdf() {
+    m_rdf = PairDistribution{};
+    m_rdfRange = 0;
 }
 
+template <size_t Dim>
+void BallsCollection<Dim>::getRdf(PairDistribution& rdf) const {
+    rdf = m_rdf;
+    rdf.dim = Dim;
+    rdf.range = m_mScale * m_rdfRange;
+    normalizePairs(rdf);
+}
+
+template <size_t Dim>
+size_t BallsCollection<Dim>::handleCell(size_t l, size_t r) {
+    size_t tested = handleBlock(l, r);
+
+    const size_t atom = m_indicies[l];
+    for (const auto& offset : halfStencil<Dim>()) {
+        uint32_t hash;
+        if (!neighbourCell(atom, offset, hash))
+            continue;
+
+        auto [first, last] = std::equal_range(m_hashes.begin(), m_hashes.begin() + m_nAtoms, hash);
+        tested += static_cast<size_t>(last - first) * (r - l);
+        for (auto it = first; it != last; ++it) {
+            size_t j = m_indicies[it - m_hashes.begin()];
+            for (size_t idx = l; idx < r; ++idx) {
+                testPair(m_indicies[idx], j);
+            }
+        }
+    }
+    return tested;
+}
 
-void BallsCollection::radixSort() {
+template <size_t Dim>
+void BallsCollection<Dim>::radixSort() {
+    TraceScope scope("radixSort");
     const uint32_t MASK = 0xff;
     std::array<size_t, 257> sums;
     for(uint32_t shift = 0; shift < 32; shift += 8) {
@@ -232,36 +1631,29 @@ void BallsCollection::radixSort() {
     }
 }
 
-void BallsCollection::handleBlock(size_t l, size_t r) {
-    if(r == l+2) {
-        size_t i = m_indicies[l];
-        size_t j = m_indicies[l+1];
-        num_t dst = 0;
-        for(size_t d = 0; d < UniverseDim; ++d) {
-            dst += (m_coords[d][i] - m_coords[d][j]) * (m_coords[d][i] - m_coords[d][j]);
-        }
-        if(dst < (m_radiuses[i] + m_radiuses[j]) * (m_radiuses[i] + m_radiuses[j])) {
-            QMutexLocker<QMutex> locker(&m_listMutex);
-            m_collisionList.push_back(std::make_pair(i, j));
-        }
-        return;
-    }
-
+template <size_t Dim>
+size_t BallsCollection<Dim>::handleBlock(size_t l, size_t r) {
     for(size_t idx = l; idx < r; ++idx) {
         for(size_t jdx = idx + 1; jdx < r; ++jdx) {
-            size_t i = m_indicies[idx];
-            size_t j = m_indicies[jdx];
-            num_t dst = 0;
-            for(size_t d = 0; d < UniverseDim; ++d) {
-                dst += (m_coords[d][i] - m_coords[d][j]) * (m_coords[d][i] - m_coords[d][j]);
-            }
-            if(dst < (m_radiuses[i] + m_radiuses[j]) * (m_radiuses[i] + m_radiuses[j])) {
-                QMutexLocker<QMutex> locker(&m_listMutex);
-                m_collisionList.push_back(std::make_pair(i, j));
-            }
+            testPair(m_indicies[idx], m_indicies[jdx]);
         }
     }
+    return (r - l) * (r - l - 1) / 2;
+}
+
+template <size_t Dim>
+void BallsCollection<Dim>::testPair(size_t i, size_t j) {
+    num_t time;
+    if(sweptContact(i, j, time)) {
+        QMutexLocker<QMutex> locker(&m_listMutex);
+        m_collisionList.push_back(std::make_pair(i, j));
+    }
 }
 
+template class detail::GasAtomProxy<2>;
+template class detail::GasAtomProxy<3>;
+
+template class BallsCollection<2>;
+template class BallsCollection<3>;
 
 }
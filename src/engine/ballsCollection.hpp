@@ -1,27 +1,47 @@
 #ifndef ENGINE_BALLSCOLLECTION_HPP
 #define ENGINE_BALLSCOLLECTION_HPP
+#include "effusionStats.hpp"
 #include "gasAtom.hpp"
+#include "msd.hpp"
+#include "parallel.hpp"
+#include "profile.hpp"
+#include "rdf.hpp"
+#include "renderBuffer.hpp"
+#include "species.hpp"
+#include "stepCounters.hpp"
+#include "thermostat.hpp"
 #include "units.hpp"
+#include "vacf.hpp"
+#include "velocityHistogram.hpp"
 
 #include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
 #include <QMutex>
 
 namespace phys {
 
+template <size_t Dim>
 class BallsCollection;
 
 namespace detail {
+    template <size_t Dim>
     class GasAtomProxy {
-        BallsCollection& m_balls;
+        BallsCollection<Dim>& m_balls;
         size_t m_index;
-        GasAtom m_atom;
+        GasAtom<Dim> m_atom;
 
-        GasAtomProxy(BallsCollection& balls, size_t index);
+        GasAtomProxy(BallsCollection<Dim>& balls, size_t index);
 
         void updateBalls();
 
-        friend BallsCollection;
+        friend BallsCollection<Dim>;
     public:
+        using Position = phys::Position<Dim>;
+        using Velocity = phys::Velocity<Dim>;
+        using Impulse = phys::Impulse<Dim>;
+
         const Mass& getMass() const {
             return m_atom.getMass();
         }
@@ -66,7 +86,7 @@ namespace detail {
            updateBalls();
         }
 
-        ImpulseMoment getImpulseMoment() const {
+        auto getImpulseMoment() const {
             return m_atom.getImpulseMoment();
         }
 
@@ -78,97 +98,413 @@ namespace detail {
            return m_atom.getKinetic();
         }
 
-        Vector<Energy> getKineticDistributed() const {
+        Vector<Energy, Dim> getKineticDistributed() const {
             return m_atom.getKineticDistributed();
         }
 
     };
 }
 
+/// What happens to an atom reaching the side of the chamber along one axis.
+enum class Boundary : uint8_t {
+    Wall = 0,     // reflected, the impulse goes to the wall pressure
+    Periodic = 1, // comes back through the opposite side, pairs use minimum-image distances
+};
+
+template <size_t Dim>
 class BallsCollection {
-    std::array<std::vector<num_t>, UniverseDim> m_coords;
-    std::array<std::vector<num_t>, UniverseDim> m_velocities;
-    std::vector<num_t> m_masses;
-    std::vector<num_t> m_radiuses;
+public:
+    using Position = phys::Position<Dim>;
+    using Velocity = phys::Velocity<Dim>;
+
+private:
+    std::array<Column<num_t>, Dim> m_coords;
+    std::array<Column<num_t>, Dim> m_velocities;
+    Column<SpeciesId> m_speciesIds;
+    Column<uint32_t> m_serials; // order of addition, render subsamples follow it through compactions
+    uint32_t m_nextSerial = 0;
     size_t m_nAtoms = 0;
 
+    std::vector<Species> m_species;
+    std::vector<size_t> m_speciesCount;
+    std::vector<num_t> m_speciesMass;   // kg
+    std::vector<num_t> m_speciesRadius; // scaled
+
+    // Pair tables indexed by a * m_species.size() + b.
+    std::vector<num_t> m_pairContact2;    // squared contact distance, scaled
+    std::vector<num_t> m_pairReducedMass; // kg
+
+    num_t m_minMass = std::numeric_limits<double>::infinity();
+    num_t m_maxMass = 0;
+    num_t m_massSum = 0;
+    num_t m_maxRadius = 0;
+
+    struct alignas(64) HistogramBins {
+        std::array<uint32_t, VelocityHistogram::Bins> speed;
+        std::array<std::array<uint32_t, VelocityHistogram::Bins>, Dim> axis;
+        num_t u2; // sum of squared mass-reduced speeds
+        size_t count;
+    };
+
+    std::array<HistogramBins, StepSize> m_histogramBins = {};
+    size_t m_histogramPeriod = 64;
+    size_t m_histogramStep = 0;
+    num_t m_histogramRange = 0;       // for the next sample, 0 until the first one
+    num_t m_histogramSampleRange = 0; // used by the last sample
 
-    friend detail::GasAtomProxy;
+
+    friend detail::GasAtomProxy<Dim>;
 
     Length m_mScale;
     Time   m_tScale;
 
-    std::array<num_t, UniverseDim> m_walls;
-public:
-    static const std::size_t MeasurementSize = 64;
-private:
-    std::array<std::array<num_t, 2 * UniverseDim>, MeasurementSize> m_wallImpulse;
+    std::array<num_t, Dim> m_walls;
+    using WallImpulses = std::array<num_t, 2 * Dim>;
+
+    struct alignas(64) ChunkImpulse {
+        WallImpulses impulse;
+    };
+
+    // Written by one chunk each and reduced into the window after the wall kernel.
+    std::array<ChunkImpulse, StepSize> m_chunkImpulse = {};
+
+    struct alignas(64) ChunkPairs {
+        size_t tested;
+        size_t cells;    // occupied cells starting in the chunk
+        size_t maxAtoms; // in one of them
+    };
+
+    // Distance checks and occupied cells of every chunk in the last handleCollisions().
+    std::array<ChunkPairs, StepSize> m_chunkPairs = {};
+
+    struct alignas(64) ChunkSweep {
+        double speed2; // bound of the squared speed in the chunk
+    };
+
+    std::array<ChunkSweep, StepSize> m_chunkSweep = {};
+
+    // Unfolded positions are m_unwrapSign * m_coords + m_unwrap: periodic crossings shift the
+    // offset, wall reflections mirror the atom, so later flight counts with the opposite sign.
+    // The offsets are empty while the MSD is off, the signs while the MSD and VACF both are.
+    std::array<Column<num_t>, Dim> m_unwrap;
+    std::array<Column<num_t>, Dim> m_unwrapSign;
+    // Positions of the origins, [level][ring slot of LagWindows][axis].
+    std::array<std::array<std::array<Column<num_t>, Dim>, MsdStats::Lags>, MsdStats::Levels> m_msdOrigin;
+    LagWindows m_msdWindows;
+    size_t m_msdPeriod = 0;
+    num_t m_msdStepTime = 0;
+    MsdStats m_msd; // scaled units, converted by getMsd()
+
+    struct alignas(64) ChunkMsd {
+        Column<num_t> sums; // [level][lag][species][axis]
+    };
+
+    std::array<ChunkMsd, StepSize> m_chunkMsd = {};
+
+    // Velocities at the VACF origins, [level][ring slot][axis], empty while it is off.
+    std::array<std::array<std::array<Column<num_t>, Dim>, VacfStats::Lags>, VacfStats::Levels> m_vacfOrigin;
+    LagWindows m_vacfWindows;
+    size_t m_vacfPeriod = 0;
+    num_t m_vacfStepTime = 0;
+    VacfStats m_vacf; // scaled units, converted by getVacf()
+
+    struct alignas(64) ChunkVacf {
+        Column<num_t> sums; // [level][lag][species], then v^2 per species
+    };
+
+    std::array<ChunkVacf, StepSize> m_chunkVacf = {};
+
+    struct alignas(64) ChunkRdf {
+        std::array<size_t, PairDistribution::Bins> pairs;
+    };
+
+    std::array<ChunkRdf, StepSize> m_chunkRdf = {};
+    PairDistribution m_rdf;
+    num_t m_rdfRange = 0; // scaled, 0 until the first sample
+
+    // Slabs along X are counted every m_profilePeriod steps, the mid-plane crossings every step.
+    size_t m_profilePeriod = 0;
+    ConcentrationProfile m_profile;
+    num_t m_profileTime = 0;       // scaled, since the profile was turned on
+    num_t m_profileSampleTime = 0; // scaled, of the last sample
+    bool m_profileSampled = false;
+    std::vector<int64_t> m_sampleCrossed; // m_profile.crossed at the last sample
+    std::vector<num_t> m_fickFlux;        // sum of J dn/dx over the sample intervals
+    std::vector<num_t> m_fickGradient2;   // sum of (dn/dx)^2 over the sample intervals
+
+    struct alignas(64) ChunkProfile {
+        Column<uint32_t> slabs;  // [species][slab]
+        Column<int64_t> crossed; // [species]
+    };
+
+    std::array<ChunkProfile, StepSize> m_chunkProfile = {};
+
+    // Applied by move() before the atoms fly. The rescale uses the temperature summed by the
+    // pass of the last step, which collisions and walls kept, so it costs no extra pass.
+    Thermostat m_thermostat;
+    ThermostatStats m_thermostatStats;
+    size_t m_thermostatStep = 0;    // steps since it was set
+    num_t m_thermostatStart = 0;    // K, start of the ramp
+    num_t m_thermostatMeasured = 0; // K after the thermostat of the last step, 0 to measure again
+    num_t m_thermostatScale = 1;    // of the velocities in this step
+    Column<num_t> m_bathSigma; // per species, velocity dispersion of the target, scaled
+
+    struct alignas(64) ChunkThermostat {
+        double energy;     // m v^2 after the thermostat, scaled units
+        double heat;       // m v^2 given by the bath collisions
+        size_t collisions;
+    };
+
+    std::array<ChunkThermostat, StepSize> m_chunkThermostat = {};
+
+    bool m_continuous = true;
+    num_t m_stepTime = 0; // dt of the last move()
+    num_t m_maxSweep = 0; // bound of the relative flight of two atoms in the last move()
+
+    // Ring of slots of m_stepsPerSlot steps each, covering the pressure measurement window.
+    std::vector<WallImpulses> m_wallImpulse = std::vector<WallImpulses>(64, WallImpulses{});
+    std::vector<size_t> m_slotSteps = std::vector<size_t>(64, 0);
+    std::size_t m_stepsPerSlot = 64;
     std::size_t m_stepIdx = 0;
 
-    std::vector<uint32_t> m_hashes;
-    std::vector<uint32_t> m_indicies;
-    std::vector<uint32_t> m_radixBuffer;
-    std::vector<uint32_t> m_radixIndiciesBuffer;
+    Column<uint32_t> m_hashes;
+    Column<uint32_t> m_indicies;
+    Column<uint32_t> m_radixBuffer;
+    Column<uint32_t> m_radixIndiciesBuffer;
 
     std::vector<uint32_t> m_cellCounter;
 
-    num_t m_cellSize;
-    std::array<uint32_t, UniverseDim> m_shifts;
+    num_t m_cellSize = 0;
+    std::array<uint32_t, Dim> m_shifts;
+
+    // Periodic axes get whole cells, so the seam is hashed like any other cell face.
+    std::array<num_t, Dim> m_cellSizes;
+    std::array<uint32_t, Dim> m_cellCounts;
+
+    std::array<Boundary, Dim> m_boundaries = {};
+
+    size_t m_hashedAtoms = 0; // atoms in the grid built by the last handleCollisions()
 
-    std::vector<std::pair<size_t, size_t>> m_collisionList;
+    Column<std::pair<size_t, size_t>> m_collisionList;
+
+    static const size_t AuditAtoms = 512;
+    Column<uint32_t> m_auditAtoms;
+    Column<std::pair<uint32_t, uint32_t>> m_auditPairs;
     QMutex m_listMutex;
 
     bool m_enableHole = false;
 
+    // Set by the wall kernel for atoms leaving through the hole, cleared by compactEscaped().
+    Column<uint8_t> m_escaped;
+
+    struct alignas(64) ChunkEffusion {
+        size_t count;
+        num_t energy; // m v^2, scaled units
+        std::array<uint32_t, EffusionStats::EnergyBins> byEnergy;
+        Column<size_t> bySpecies;
+    };
+
+    std::array<ChunkEffusion, StepSize> m_chunkEffusion = {};
+    EffusionStats m_effusion;
+    size_t m_deleted = 0; // by the last handleWallCollisions()
+    num_t m_effusionBinWidth = 0; // m v^2 per energy bin, scaled units
+
+    // Columns are written by one thread while atoms are added, move() spreads them over the nodes.
+    bool m_placed = true;
+
+    // Per-chunk grids of (count, sum) of fillField(), so chunks never write the same bin.
+    mutable std::array<Column<std::pair<float, num_t>>, StepSize> m_fieldPartial;
+
+    std::array<Column<num_t>, Dim> m_coordsScratch;
+    std::array<Column<num_t>, Dim> m_velocitiesScratch;
+    Column<SpeciesId> m_speciesIdsScratch;
+    Column<uint32_t> m_serialsScratch;
+
+    // Per-chunk (count, m v^2) of every species for getSpeciesMetrics().
+    mutable std::array<std::vector<std::pair<size_t, num_t>>, StepSize> m_speciesPartial;
+
 public:
     BallsCollection(Length meterScale, Time timeScale) : m_mScale(meterScale), m_tScale(timeScale) {}
 
     ImpulseVal getWallImpulse(size_t i) const {
         num_t val;
-        for(size_t t = 0; t < MeasurementSize;t++) {
+        for(size_t t = 0; t < m_wallImpulse.size();t++) {
             val += m_wallImpulse[t][i];
         }
         return std::abs(val) * m_mScale / m_tScale * Mass{1};
     }
 
+    /// Steps the wall impulses currently cover, at most the window length.
+    size_t getMeasuredSteps() const {
+        return std::accumulate(m_slotSteps.begin(), m_slotSteps.end(), size_t{0});
+    }
+
+    /// Pressure is averaged over slots * stepsPerSlot steps; changing it restarts the window.
+    void setMeasurementWindow(size_t slots, size_t stepsPerSlot);
+
     template<typename F>
     void addAtoms(size_t N, F generator) {
         for(size_t i = 0; i < N; ++i) {
-            GasAtom atom = generator();
-            for(size_t j = 0; j < UniverseDim; ++j) {
+            GasAtom<Dim> atom = generator();
+            for(size_t j = 0; j < Dim; ++j) {
                 m_coords    [j].push_back(*(atom.getPos()     [j] / m_mScale));
                 m_velocities[j].push_back(*(atom.getVelocity()[j] / m_mScale * m_tScale));
             }
-            m_masses  .push_back(*atom.getMass());
-            m_radiuses.push_back(*(atom.getRadius() / m_mScale));
+            SpeciesId id = addSpecies(atom.getMass(), atom.getRadius());
+            m_speciesIds.push_back(id);
+            m_serials.push_back(m_nextSerial++);
+            m_speciesCount[id]++;
+            m_massSum += m_speciesMass[id];
             m_nAtoms++;
         }
 
+        m_escaped            .resize(m_nAtoms, 0);
         m_hashes             .resize(m_nAtoms);
         m_indicies           .resize(m_nAtoms);
         m_radixBuffer        .resize(m_nAtoms);
         m_radixIndiciesBuffer.resize(m_nAtoms);
+        m_placed = false;
+        m_thermostatMeasured = 0;
     }
 
     void setWalls(Position pos) {
-        for(size_t i = 0; i < UniverseDim; ++i) {
+        for(size_t i = 0; i < Dim; ++i) {
             m_walls[i] = *(pos[i] / m_mScale);
         }
     }
 
+    Length getWall(size_t axis) const {
+        return m_mScale * m_walls[axis];
+    }
+
+    /// Id of the species with this mass and radius, registered on first use.
+    SpeciesId addSpecies(Mass mass, Length radius);
+
+    size_t getSpeciesCount() const {
+        return m_species.size();
+    }
+
+    const Species& getSpecies(SpeciesId id) const {
+        return m_species[id];
+    }
+
+    SpeciesId getSpeciesId(size_t i) const {
+        return m_speciesIds[i];
+    }
+
+    /// Contact distance of two species.
+    Length getContact(SpeciesId a, SpeciesId b) const {
+        return m_mScale * std::sqrt(m_pairContact2[a * m_species.size() + b]);
+    }
+
+    Mass getReducedMass(SpeciesId a, SpeciesId b) const {
+        return Mass{m_pairReducedMass[a * m_species.size() + b]};
+    }
+
+    void getSpeciesMetrics(std::vector<SpeciesMetrics>& metrics) const;
+
+    /// Elastic collision response at the first contact of two atoms in the last step, false if
+    /// they did not touch or are already parting.
+    bool resolveCollision(size_t i, size_t j);
+
+    /// Pairs are also found and resolved when they touched during the step and parted again.
+    void setContinuous(bool continuous) {
+        m_continuous = continuous;
+    }
+
     void setCellSize(Length l);
 
-    detail::GasAtomProxy operator[](size_t i) {return detail::GasAtomProxy(*this, i);}
+    Length getCellSize() const {
+        return m_mScale * m_cellSize;
+    }
+
+    /// Smallest cell that still holds an atom diameter and the flight of the last step,
+    /// and fits the grid into the 32 bit hash.
+    Length getMinCellSize() const;
+
+    Length getMaxCellSize() const {
+        return m_mScale * *std::max_element(m_walls.begin(), m_walls.end());
+    }
+
+    /// Of the grid of the last handleCollisions(), counted by its pair pass.
+    CellOccupancy getOccupancy() const;
+
+    /// Distance checks done by the last handleCollisions().
+    size_t getPairsTested() const {
+        size_t tested = 0;
+        for (const auto& chunk : m_chunkPairs) {
+            tested += chunk.tested;
+        }
+        return tested;
+    }
+
+    /// Atoms removed by the last handleWallCollisions().
+    size_t getDeleted() const {
+        return m_deleted;
+    }
+
+    /// Takes effect with the next step; atoms of a periodic axis are wrapped into [0, wall).
+    void setBoundary(size_t axis, Boundary boundary);
+
+    Boundary getBoundary(size_t axis) const {
+        return m_boundaries[axis];
+    }
+
+    /// Shortest vector from atom j to atom i, through the periodic sides if needed.
+    Position getSeparation(size_t i, size_t j) const;
+
+    detail::GasAtomProxy<Dim> operator[](size_t i) {return detail::GasAtomProxy<Dim>(*this, i);}
+
+    GasAtom<Dim> getAtom(size_t i) const;
+
+    Vector<Energy, Dim> getKineticDistributed() const;
+
+    /// Total momentum of the atoms.
+    Impulse<Dim> getMomentum() const;
+
+    void fillRenderBuffer(const RenderOptions& options, Column<RenderAtom>& buffer) const;
+
+    /// Bins of options.field over X and Y, counts gets the atoms of every bin.
+    void fillField(const RenderOptions& options, Column<float>& field, Column<float>& counts) const;
+
+    void getVelocityHistogram(VelocityHistogram& hist) const;
+
+    /// Steps between velocity histogram samples, 0 turns sampling off.
+    void setHistogramPeriod(size_t period) {
+        m_histogramPeriod = period;
+    }
+
+    /// Steps between MSD samples of level 0, 0 turns the tracking off and frees its columns.
+    void setMsdPeriod(size_t period);
+
+    void getMsd(MsdStats& stats) const;
+
+    /// Steps between VACF samples of level 0, 0 turns it off and frees its columns.
+    void setVacfPeriod(size_t period);
+
+    void getVacf(VacfStats& stats) const;
 
-    void deleteAtom(size_t i);
+    /// Steps between concentration profile samples, 0 turns it off. Setting it starts over.
+    void setProfilePeriod(size_t period);
 
-    GasAtom getAtom(size_t i) const;
+    void getProfile(ConcentrationProfile& profile) const;
+
+    /// Takes effect with the next step, setting it starts the ramp over.
+    void setThermostat(const Thermostat& thermostat);
+
+    const Thermostat& getThermostat() const {
+        return m_thermostat;
+    }
+
+    const ThermostatStats& getThermostatStats() const {
+        return m_thermostatStats;
+    }
 
     void move(Time dt);
 
     size_t size() const {return m_nAtoms;}
 
-    void push_back(const GasAtom& atom) {
+    void push_back(const GasAtom<Dim>& atom) {
         addAtoms(1, [&](){return atom;});
     }
 
@@ -176,15 +512,162 @@ public:
     
     void handleCollisions();
 
-    const std::vector<std::pair<size_t, size_t>>& getCollisions() { return m_collisionList; }
+    const Column<std::pair<size_t, size_t>>& getCollisions() const { return m_collisionList; }
+
+    /**
+     * @brief Compares the pairs of the last handleCollisions() with a brute-force search.
+     *
+     * The window is a random box holding about AuditAtoms atoms, only pairs with both
+     * atoms inside it are counted. Call it before the atoms move.
+     */
+    void auditBroadPhase(std::minstd_rand& random, BroadPhaseAudit& audit);
+
+    /**
+     * @brief Adds the pair distances of the grid of the last handleCollisions() to g(r).
+     *
+     * Pairs are looked up in the cells up to RdfReach cells away, so r ends at that many
+     * widths of the smallest cell. Call it before the atoms move.
+     */
+    void sampleRdf();
+
+    void resetRdf();
+
+    void getRdf(PairDistribution& rdf) const;
     void setEnableHole(bool newEnableHole);
 
+    const EffusionStats& getEffusionStats() const {
+        return m_effusion;
+    }
+
 private:
+    /// Calls func(column, scratch) for every per-atom column of the atoms themselves.
+    template <typename F>
+    void forEachColumn(F func) {
+        for (size_t d = 0; d < Dim; ++d) {
+            func(m_coords[d], m_coordsScratch[d]);
+            func(m_velocities[d], m_velocitiesScratch[d]);
+        }
+        func(m_speciesIds, m_speciesIdsScratch);
+        func(m_serials, m_serialsScratch);
+    }
+
+    /// Most MSD and VACF columns at once, see forEachCorrelatorColumn().
+    static const size_t CorrelatorColumns = Dim * (2 + MsdStats::Levels * MsdStats::Lags + VacfStats::Levels * VacfStats::Lags);
+
+    /// Calls func(column) for every MSD and VACF column that covers every atom.
+    template <typename F>
+    void forEachCorrelatorColumn(F func) {
+        auto live = [this, &func] (Column<num_t>& column) {
+            if (column.size() == m_nAtoms) {
+                func(column);
+            }
+        };
+        for (size_t d = 0; d < Dim; ++d) {
+            live(m_unwrap[d]);
+            live(m_unwrapSign[d]);
+        }
+        for (auto& level : m_msdOrigin) {
+            for (auto& origin : level) {
+                for (auto& column : origin) {
+                    live(column);
+                }
+            }
+        }
+        for (auto& level : m_vacfOrigin) {
+            for (auto& origin : level) {
+                for (auto& column : origin) {
+                    live(column);
+                }
+            }
+        }
+    }
+
+    num_t mass(size_t i) const {
+        return m_speciesMass[m_speciesIds[i]];
+    }
+
+    num_t radius(size_t i) const {
+        return m_speciesRadius[m_speciesIds[i]];
+    }
+
+    num_t separation(size_t d, size_t i, size_t j) const {
+        num_t diff = m_coords[d][i] - m_coords[d][j];
+        if (m_boundaries[d] == Boundary::Periodic) {
+            if (diff > m_walls[d] / 2) {
+                diff -= m_walls[d];
+            } else if (diff < -m_walls[d] / 2) {
+                diff += m_walls[d];
+            }
+        }
+        return diff;
+    }
+
+    void placeColumns();
+
+    void countEscaped(size_t chunk, size_t i);
+
+    void compactEscaped();
+
+    void sampleHistogram(size_t chunk, size_t l, size_t r, num_t meanMass);
+
+    /// Windows start over from the current positions, the sums are kept.
+    void restartMsd();
+
+    /// Levels sampled by this step as a bit mask, 0 if none.
+    uint32_t startMsdSample(num_t time);
+
+    void sampleMsd(size_t chunk, size_t l, size_t r, uint32_t levels);
+
+    void finishMsdSample(uint32_t levels);
+
+    num_t unfolded(size_t d, size_t i) const {
+        return m_unwrapSign[d][i] * m_coords[d][i] + m_unwrap[d][i];
+    }
+
+    void restartVacf();
+
+    uint32_t startVacfSample(num_t time);
+
+    void sampleVacf(size_t chunk, size_t l, size_t r, uint32_t levels);
+
+    void finishVacfSample(uint32_t levels);
+
+    /// Clears the chunk bins, true if the step samples the slabs.
+    bool startProfile();
+
+    /// Counts the mid-plane crossings of the step and the slabs of a sample.
+    void profileChunk(size_t chunk, size_t l, size_t r, num_t time, bool sample);
+
+    void finishProfile(num_t time, bool sample);
+
+    /// Sets the scale or the bath of this step, false if the thermostat is off.
+    bool startThermostat();
+
+    /// Rescales the velocities or lets the atoms collide with the bath, sums m v^2 after it.
+    void thermostatChunk(size_t chunk, size_t l, size_t r);
+
+    void finishThermostat();
+
     void radixSort();
     
-    void handleSub(size_t i, size_t j);
+    uint32_t cellOf(size_t d, size_t i) const {
+        return std::min(static_cast<uint32_t>(m_coords[d][i] / m_cellSizes[d]), m_cellCounts[d] - 1);
+    }
+
+    /// Sorted atoms [l, r) share a cell; tests them with each other and with the neighbour cells.
+    /// Returns the number of pairs tested.
+    size_t handleCell(size_t l, size_t r);
+
+    size_t handleBlock(size_t i, size_t j);
+
+    /// Hash of the cell offset from the cell of the atom, false if it is outside the grid.
+    bool neighbourCell(size_t atom, const std::array<int, Dim>& offset, uint32_t& hash) const;
+
+    void testPair(size_t i, size_t j);
 
-    void handleBlock(size_t i, size_t j);
+    /// True if the atoms overlap or touched during the last step, time of the first contact
+    /// in [-dt, 0] relative to the end of the step.
+    bool sweptContact(size_t i, size_t j, num_t& time) const;
 };
 
 }
@@ -0,0 +1,51 @@
+#include "cellTuner.hpp"
+#include <algorithm>
+
+namespace phys {
+
+bool CellTuner::update(size_t nAtoms) {
+    if (tuning())
+        return false;
+
+    m_sinceTune++;
+    return m_dirty || m_sinceTune >= RetuneSteps ||
+           3 * nAtoms > 4 * m_tunedAtoms || 3 * nAtoms < 2 * m_tunedAtoms;
+}
+
+void CellTuner::start(Length guess, Length minSize, Length maxSize, size_t nAtoms) {
+    for (size_t i = 0; i < Candidates.size(); ++i) {
+        m_sizes[i] = std::clamp(guess * num_t{Candidates[i]}, minSize, std::max(minSize, maxSize));
+    }
+    m_times.fill(0);
+    m_candidate = 0;
+    m_trial = 0;
+
+    m_dirty = false;
+    m_tunedAtoms = nAtoms;
+    m_sinceTune = 0;
+}
+
+Length CellTuner::current() const {
+    return tuning() ? m_sizes[m_candidate] : m_best;
+}
+
+bool CellTuner::record(double seconds) {
+    if (!tuning())
+        return false;
+
+    // The first step of every candidate is a warm-up and is not timed.
+    if (m_trial++ != 0) {
+        m_times[m_candidate] += seconds;
+    }
+    if (m_trial <= TrialSteps)
+        return false;
+
+    m_trial = 0;
+    if (++m_candidate < Candidates.size())
+        return false;
+
+    m_best = m_sizes[std::min_element(m_times.begin(), m_times.end()) - m_times.begin()];
+    return true;
+}
+
+} // namespace phys
@@ -0,0 +1,62 @@
+#ifndef ENGINE_CELLTUNER_HPP
+#define ENGINE_CELLTUNER_HPP
+
+#include "units.hpp"
+#include <array>
+
+namespace phys {
+
+/**
+ * @brief Picks the broad phase cell size that makes the collision phase fastest.
+ *
+ * A round starts from a guess (from the occupancy of the current grid) and times the
+ * collision phase of TrialSteps steps for every candidate around it, the fastest one is kept.
+ * Rounds are started by the owner when update() says so: after invalidate(), after the
+ * atom count moved by more than a third, or every RetuneSteps steps.
+ */
+class CellTuner {
+public:
+    static const size_t TrialSteps = 8;
+    static const size_t RetuneSteps = 4096;
+
+    static constexpr std::array<double, 5> Candidates = {0.6, 0.8, 1., 1.25, 1.6};
+
+    /// Walls or boundaries changed: drops the running round, the next update() starts a new one.
+    void invalidate() {
+        m_dirty = true;
+        m_candidate = Candidates.size();
+    }
+
+    /// Counts a step, true if a round should start now.
+    bool update(size_t nAtoms);
+
+    /**
+     * @brief Starts a round of candidates around guess, clamped to [minSize, maxSize].
+     */
+    void start(Length guess, Length minSize, Length maxSize, size_t nAtoms);
+
+    bool tuning() const {
+        return m_candidate < Candidates.size();
+    }
+
+    /// Cell size the coming step runs with while tuning(), otherwise the last pick.
+    Length current() const;
+
+    /// Collision phase time of the step run with current(). Returns true when the round ended.
+    bool record(double seconds);
+
+private:
+    std::array<Length, Candidates.size()> m_sizes;
+    std::array<double, Candidates.size()> m_times;
+    size_t m_candidate = Candidates.size();
+    size_t m_trial = 0;
+    Length m_best{};
+
+    bool m_dirty = true;
+    size_t m_tunedAtoms = 0;
+    size_t m_sinceTune = 0;
+};
+
+} // namespace phys
+
+#endif /* ENGINE_CELLTUNER_HPP */
@@ -1,21 +1,24 @@
 #include "chamber.hpp"
 #include <QtConcurrent/QtConcurrent>
+#include <chrono>
 
 namespace phys {
 
-void Chamber::fillRandom(size_t N, VelocityVal maxV, Mass m, Length r) {
+template <size_t Dim>
+void ChamberImpl<Dim>::fillRandom(size_t N, VelocityVal maxV, Mass m, Length r) {
     for (size_t i = 0; i < N; ++i) {
-        Velocity v = randomSphere<Unit<num_t>>() * maxV;
+        Velocity v = randomSphere<Unit<num_t>, Dim>() * maxV;
         v *= randomShift();
-        m_atoms.push_back(GasAtom{randomInCube(m_chamberCorner) *= 0.9, v, m, r});
+        m_atoms.push_back(GasAtom<Dim>{randomInCube(m_chamberCorner) *= 0.9, v, m, r});
     }
 }
 
-void Chamber::fillRandomHalf(size_t N, VelocityVal maxV, Mass m, Length r, int half) {
+template <size_t Dim>
+void ChamberImpl<Dim>::fillRandomHalf(size_t N, VelocityVal maxV, Mass m, Length r, int half) {
     Position pos = m_chamberCorner;
     pos[0] /= 2; 
     for (size_t i = 0; i < N; ++i) {
-        Velocity v = randomSphere<Unit<num_t>>() * maxV;
+        Velocity v = randomSphere<Unit<num_t>, Dim>() * maxV;
         v *= randomShift();
         
         Position rv = randomInCube(pos);
@@ -23,127 +26,229 @@ void Chamber::fillRandomHalf(size_t N, VelocityVal maxV, Mass m, Length r, int h
         if(half == 1) 
             rv[0] += pos[0];
 
-        m_atoms.push_back(GasAtom{rv, v, m, r});
+        m_atoms.push_back(GasAtom<Dim>{rv, v, m, r});
     }
 }
 
-void Chamber::fillRandomAxis(size_t N, VelocityVal maxV, Mass m, Length r, size_t axis) {
+template <size_t Dim>
+void ChamberImpl<Dim>::fillRandomAxis(size_t N, VelocityVal maxV, Mass m, Length r, size_t axis) {
     for (size_t i = 0; i < N; ++i) {
         Velocity v{};
         v[axis] = maxV * randomShift();
-        m_atoms.push_back(GasAtom{randomInCube(m_chamberCorner) *= 0.9, v, m, r});
+        m_atoms.push_back(GasAtom<Dim>{randomInCube(m_chamberCorner) *= 0.9, v, m, r});
     }
 }
 
-void Chamber::updateCellSize()
+template <size_t Dim>
+void ChamberImpl<Dim>::updateCellSize()
 {
-    m_atoms.setCellSize(m_chamberCorner.X() / std::pow(m_atoms.size(), 1.0 / UniverseDim));
+    if (!(m_atoms.getMaxCellSize() > Length{0}))
+        return;
+    m_atoms.setCellSize(std::clamp(m_atoms.getCellSize(), m_atoms.getMinCellSize(), m_atoms.getMaxCellSize()));
+    m_cellTuner.invalidate();
 }
 
-void Chamber::step() {
+template <size_t Dim>
+void ChamberImpl<Dim>::startCellTuning()
+{
+    // Cells holding AtomsPerCell atoms, measured on the current grid once there is one.
+    num_t scale = 1;
+    Length guess = m_atoms.getCellSize();
+    CellOccupancy occupancy = m_atoms.getOccupancy();
+    if (occupancy.cells != 0) {
+        scale = num_t{AtomsPerCell} / occupancy.mean;
+    } else {
+        num_t volume = 1;
+        for (size_t i = 0; i < Dim; ++i) {
+            volume *= *(m_chamberCorner[i] / guess);
+        }
+        scale = volume * num_t{AtomsPerCell} / num_t{std::max<size_t>(1, m_atoms.size())};
+    }
+    guess *= num_t{std::pow(static_cast<double>(scale), 1.0 / Dim)};
+
+    m_cellTuner.start(guess, m_atoms.getMinCellSize(), m_atoms.getMaxCellSize(), m_atoms.size());
+    m_atoms.setCellSize(m_cellTuner.current());
+}
+
+template <size_t Dim>
+void ChamberImpl<Dim>::step() {
+    using Clock = TraceClock;
+    auto seconds = [] (Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double>(to - from).count();
+    };
+
+    StepCounters counters;
+    counters.step = m_counters.step + 1;
+    const AllocationStats allocated = getAllocationStats();
+
+    auto start = Clock::now();
     m_atoms.move(m_dt);
+    auto moved = Clock::now();
 
     m_atoms.handleWallCollisions();
+    auto walled = Clock::now();
+    counters.phaseSeconds[static_cast<size_t>(StepPhase::Move)] = seconds(start, moved);
+    counters.phaseSeconds[static_cast<size_t>(StepPhase::Walls)] = seconds(moved, walled);
+    traceSpan(phaseName(StepPhase::Move), -1, start, moved);
+    traceSpan(phaseName(StepPhase::Walls), -1, moved, walled);
+    counters.deleted = m_atoms.getDeleted();
 
     if (m_enableCollision) {
-#if 0
-        for (size_t i = 0; i < m_atoms.size(); ++i) {
-            for (size_t j = i + 1; j < m_atoms.size(); ++j) {
-                handleCollision(i, j);
-            }
+        if (m_cellTuner.update(m_atoms.size())) {
+            startCellTuning();
         }
-#else 
+        // The flight of this step may have outgrown the cells.
+        if (m_atoms.getCellSize() < m_atoms.getMinCellSize()) {
+            m_atoms.setCellSize(m_atoms.getMinCellSize());
+        }
+        auto broadStart = Clock::now();
+
         m_atoms.handleCollisions();
+        auto broadEnd = Clock::now();
+
+        // Resolution moves the atoms back to their contact points, the audit and g(r) see the grid's positions.
+        if (m_auditPeriod != 0 && counters.step % m_auditPeriod == 0) {
+            TraceScope scope("audit");
+            m_atoms.auditBroadPhase(m_auditRandom, m_audit);
+        }
+        if (m_rdfPeriod != 0 && counters.step % m_rdfPeriod == 0) {
+            TraceScope scope("rdf");
+            m_atoms.sampleRdf();
+        }
+        auto resolveStart = Clock::now();
 
         const auto& lst = m_atoms.getCollisions();
         for(auto [i, j] : lst) {
-            handleCollision(i, j);
+            counters.collisionsResolved += handleCollision(i, j);
         }
-#endif
+        auto resolved = Clock::now();
+
+        counters.phaseSeconds[static_cast<size_t>(StepPhase::BroadPhase)] = seconds(broadStart, broadEnd);
+        counters.phaseSeconds[static_cast<size_t>(StepPhase::Resolve)] = seconds(resolveStart, resolved);
+        traceSpan(phaseName(StepPhase::BroadPhase), -1, broadStart, broadEnd);
+        traceSpan(phaseName(StepPhase::Resolve), -1, resolveStart, resolved);
+        counters.pairsTested = m_atoms.getPairsTested();
+        counters.collisionsFound = lst.size();
+        counters.occupancy = m_atoms.getOccupancy();
+
+        if (m_cellTuner.tuning()) {
+            m_cellTuner.record(seconds(broadStart, broadEnd) + seconds(resolveStart, resolved));
+            m_atoms.setCellSize(m_cellTuner.current());
+        }
+    }
+
+    if (m_invariantPeriod != 0 && counters.step % m_invariantPeriod == 0) {
+        TraceScope scope("invariants");
+        m_violations += m_monitor.check(m_atoms, counters.step);
     }
+
+    const AllocationStats total = getAllocationStats();
+    counters.allocated = {total.count - allocated.count, total.bytes - allocated.bytes};
+    m_counters = counters;
     m_time += m_dt;
+    traceSpan("step", -1, start, Clock::now());
 }
 
-void Chamber::getMetrics(Metrics& metrics) const {
-    metrics.chamberCorner = m_chamberCorner;
+template <size_t Dim>
+void ChamberImpl<Dim>::getMetrics(Metrics& metrics) const {
+    metrics.dim = Dim;
+    metrics.chamberCorner = {};
+    metrics.kineticEnergy = {};
+    const auto kinetic = m_atoms.getKineticDistributed();
+    for (size_t i = 0; i < Dim; ++i) {
+        metrics.chamberCorner[i] = m_chamberCorner[i];
+        metrics.kineticEnergy[i] = kinetic[i];
+    }
 
-    metrics.kineticEnergy = Energy{};
-    metrics.atoms.resize(m_atoms.size());
+    metrics.nAtoms = m_atoms.size();
+    if (metrics.render.field == FieldKind::None) {
+        m_atoms.fillRenderBuffer(metrics.render, metrics.atoms);
+        // Z is constant in 2D, there is nothing to sort.
+        if (metrics.render.depthSorted && Dim == 3) {
+            sortByDepth(metrics.atoms, metrics.depthBuffer);
+        }
+        metrics.field.clear();
+        metrics.fieldCounts.clear();
+    } else {
+        m_atoms.fillField(metrics.render, metrics.field, metrics.fieldCounts);
+        metrics.atoms.clear();
+    }
 
-    for(size_t i = 0; i < m_atoms.size(); ++i) {
-        metrics.atoms[i] = m_atoms.getAtom(i);
-        metrics.kineticEnergy += metrics.atoms[i].getKineticDistributed();
+    if (metrics.render.followIdx < m_atoms.size()) {
+        GasAtom<Dim> atom = m_atoms.getAtom(metrics.render.followIdx);
+        Corner pos;
+        phys::Velocity<MaxDim> v;
+        for (size_t i = 0; i < Dim; ++i) {
+            pos[i] = atom.getPos()[i];
+            v[i] = atom.getVelocity()[i];
+        }
+        metrics.followed = GasAtom<MaxDim>{pos, v, atom.getMass(), atom.getRadius()};
+        metrics.followedSpecies = m_atoms.getSpeciesId(metrics.render.followIdx);
     }
 
+    m_atoms.getVelocityHistogram(metrics.velocities);
+    metrics.effusion = m_atoms.getEffusionStats();
+    m_atoms.getSpeciesMetrics(metrics.species);
+    metrics.allocations = getAllocationStats();
+    metrics.counters = m_counters;
+    metrics.invariantViolations = m_violations;
+    metrics.audit = m_audit;
+    m_atoms.getMsd(metrics.msd);
+    m_atoms.getVacf(metrics.vacf);
+    m_atoms.getRdf(metrics.rdf);
+    m_atoms.getProfile(metrics.profile);
+    metrics.thermostat = m_atoms.getThermostatStats();
+
     metrics.time = m_time;
-    metrics.volume = Volume{1.};
+    VolumeVal<Dim> volume{1.};
 
-    for (size_t i = 0; i < UniverseDim; ++i) {
-        metrics.volume *= *m_chamberCorner[i]; // HACK: I sozdal. I ignore.
+    for (size_t i = 0; i < Dim; ++i) {
+        volume *= *m_chamberCorner[i]; // HACK: I sozdal. I ignore.
     }
+    metrics.volume = *volume;
 
-    for (size_t i = 0; i < 2 * UniverseDim; ++i) {
-        metrics.pressure[i] = m_atoms.getWallImpulse(i) / (m_dt * num_t{m_atoms.MeasurementSize * m_atoms.MeasurementSize}) /
-                              (metrics.volume / m_chamberCorner[i / 2]);
-        if (metrics.pressure[i] < Pressure{0.})
-            metrics.pressure[i] *= -1.;
+    metrics.pressure.fill(0);
+    for (size_t i = 0; i < 2 * Dim; ++i) {
+        PressureVal<Dim> pressure = m_atoms.getWallImpulse(i) / (m_dt * num_t{std::max<size_t>(1, m_atoms.getMeasuredSteps())}) /
+                                    (volume / m_chamberCorner[i / 2]);
+        metrics.pressure[i] = std::abs(*pressure);
     }
 }
 
-void Chamber::setXLength(Length len)
+template <size_t Dim>
+void ChamberImpl<Dim>::setPressureWindow(Time window)
+{
+    const size_t MaxSlots = 64;
+    size_t steps = std::max<size_t>(1, static_cast<size_t>(*(window / m_dt) + num_t{0.5}));
+    size_t slots = std::min(MaxSlots, steps);
+    m_atoms.setMeasurementWindow(slots, (steps + slots - 1) / slots);
+}
+
+template <size_t Dim>
+void ChamberImpl<Dim>::setXLength(Length len)
 {
     m_chamberCorner[0] = len;
     m_atoms.setWalls(m_chamberCorner);
+    updateCellSize();
 }
 
-bool Chamber::hasCollision(size_t i, size_t j) {
-    return (m_atoms[i].getPos() - m_atoms[j].getPos()).Len2() <
-           (m_atoms[i].getRadius() + m_atoms[j].getRadius()) *
-               (m_atoms[i].getRadius() + m_atoms[j].getRadius());
+template <size_t Dim>
+bool ChamberImpl<Dim>::hasCollision(size_t i, size_t j) {
+    Length contact = m_atoms.getContact(m_atoms.getSpeciesId(i), m_atoms.getSpeciesId(j));
+    return m_atoms.getSeparation(i, j).Len2() < contact * contact;
 }
 
-void Chamber::handleCollision(size_t i, size_t j) {
-    if (!hasCollision(i, j))
-        return;
-    m_atoms[i].collide(m_time);
-    m_atoms[j].collide(m_time);
-
-    Velocity v1 = m_atoms[i].getVelocity();
-    Velocity v2 = m_atoms[j].getVelocity();
-
-    Mass m1 = m_atoms[i].getMass();
-    Mass m2 = m_atoms[j].getMass();
-
-    Position r1 = m_atoms[i].getPos();
-    Position r2 = m_atoms[j].getPos();
-
-    auto axis = Normalize(r2 - r1);
-
-    VelocityVal pj1 = (v1, axis);
-    VelocityVal pj2 = (v2, axis);
-
-    if(pj1 < pj2) {
-        return;
-    }
-
-    v1 -= axis * pj1;
-    v2 -= axis * pj2;
-
-    VelocityVal nex_pj1 = ((m2* pj2 *= 2.) + pj1 * (m1 - m2)) / (m1 + m2);
-    VelocityVal nex_pj2 = ((m1* pj1 *= 2.) + pj2 * (m2 - m1)) / (m1 + m2);
-
-    v1 += axis * nex_pj1;
-    v2 += axis * nex_pj2;
-
-    m_atoms[i].setVelocity(v1);
-    m_atoms[j].setVelocity(v2);
+template <size_t Dim>
+bool ChamberImpl<Dim>::handleCollision(size_t i, size_t j) {
+    return m_atoms.resolveCollision(i, j);
 }
 
-void Chamber::handleWallCollision(size_t i) {
+template <size_t Dim>
+void ChamberImpl<Dim>::handleWallCollision(size_t i) {
     Position r = m_atoms[i].getPos();
     Velocity v = m_atoms[i].getVelocity();
 
-    for (size_t j = 0; j < UniverseDim; ++j) {
+    for (size_t j = 0; j < Dim; ++j) {
         if (r[j] < m_atoms[i].getRadius()) {
             r[j] = ((m_atoms[i].getRadius()) * num_t{2}) - r[j];
             v[j] = -v[j];
@@ -160,4 +265,15 @@ void Chamber::handleWallCollision(size_t i) {
     }
 }
 
+std::unique_ptr<Chamber> Chamber::create(size_t dim, Corner corner) {
+    if (dim == 2) {
+        return std::make_unique<ChamberImpl<2>>(corner);
+    }
+    assert(dim == 3);
+    return std::make_unique<ChamberImpl<3>>(corner);
+}
+
+template class ChamberImpl<2>;
+template class ChamberImpl<3>;
+
 } // namespace phys
@@ -2,17 +2,134 @@
 #define ENGINE_UNIVERSE_HPP
 
 #include "ballsCollection.hpp"
+#include "cellTuner.hpp"
 #include "gasAtom.hpp"
+#include "invariantMonitor.hpp"
+
+#include <memory>
 
 namespace phys {
 
 const Time defaultDeltaTime = 1e4_sec;
 const size_t AtomsPerCell = 10;
 
+/**
+ * @brief Chamber of any supported dimension as the GUI and the drivers see it.
+ *
+ * Vectors passed in and out are MaxDim long, components past dim() are ignored and come back zero.
+ */
 class Chamber {
+public:
+    using Corner = Position<MaxDim>;
+
+    enum ChamberWall {
+        Left = 0,
+        Right,
+        Top,
+        Bottom,
+        Front,
+        Back,
+    };
+
+    struct Metrics {
+        RenderOptions render;
+        size_t dim = MaxDim;
+        Corner chamberCorner;
+        Column<RenderAtom> atoms;
+        Column<RenderAtom> depthBuffer;
+        Column<float> field;
+        Column<float> fieldCounts; // atoms per bin of field
+        size_t nAtoms = 0;
+        GasAtom<MaxDim> followed;
+        SpeciesId followedSpecies = 0;
+        num_t volume = 0; // m^dim
+        Vector<Energy, MaxDim> kineticEnergy;
+        std::array<num_t, 2 * MaxDim> pressure{}; // Pa in 3D, N/m in 2D
+        Time time;
+        VelocityHistogram velocities;
+        EffusionStats effusion;
+        std::vector<SpeciesMetrics> species;
+        AllocationStats allocations;
+        StepCounters counters;
+        size_t invariantViolations = 0; // since the start
+        BroadPhaseAudit audit;
+        MsdStats msd;
+        VacfStats vacf;
+        PairDistribution rdf;
+        ConcentrationProfile profile;
+        ThermostatStats thermostat;
+    };
+
+    /// Chamber of dim dimensions, 2 or 3.
+    static std::unique_ptr<Chamber> create(size_t dim, Corner corner);
+
+    virtual ~Chamber() = default;
+
+    virtual size_t dim() const = 0;
+
+    virtual void fillRandom(size_t N, VelocityVal maxV, Mass m, Length r) = 0;
+
+    virtual void fillRandomAxis(size_t N, VelocityVal maxV, Mass m, Length r, size_t axis = 0) = 0;
+
+    virtual void fillRandomHalf(size_t N, VelocityVal maxV, Mass m, Length r, int half) = 0;
+
+    virtual void setWalls(Corner pos) = 0;
+
+    virtual void step() = 0;
+
+    virtual void getMetrics(Metrics& metrics) const = 0;
+
+    /// Counters of the last step, without the occupancy.
+    virtual const StepCounters& getCounters() const = 0;
+
+    virtual void setDT(Time dt) = 0;
+
+    virtual void setXLength(Length len) = 0;
+
+    virtual void openHole(bool open) = 0;
+
+    /// The hole is in the wall at X = 0, so it only works while X is a wall.
+    virtual void setBoundary(size_t axis, Boundary boundary) = 0;
+
+    /// Time the wall pressure is averaged over, rounded to whole steps of the current dt.
+    virtual void setPressureWindow(Time window) = 0;
+
+    virtual void setHistogramPeriod(size_t steps) = 0;
+
+    /// Steps between invariant checks, 0 turns them off.
+    virtual void setInvariantPeriod(size_t steps) = 0;
+
+    /// Steps between brute-force checks of the broad phase, 0 turns them off.
+    virtual void setAuditPeriod(size_t steps) = 0;
+
+    /// Collisions of atoms that passed through each other during a step are found too.
+    virtual void setContinuousCollisions(bool continuous) = 0;
+
+    /// Steps between samples of the mean squared displacement, 0 turns it off.
+    virtual void setMsdPeriod(size_t steps) = 0;
+
+    /// Steps between samples of the velocity autocorrelation, 0 turns it off.
+    virtual void setVacfPeriod(size_t steps) = 0;
+
+    /// Steps between g(r) samples, 0 turns them off. Changing it starts g(r) over.
+    virtual void setRdfPeriod(size_t steps) = 0;
+
+    /// Steps between samples of the concentration profile along X, 0 turns it off.
+    virtual void setProfilePeriod(size_t steps) = 0;
+
+    /// Heat bath applied from the next step on, ThermostatMode::Off turns it off.
+    virtual void setThermostat(const Thermostat& thermostat) = 0;
+};
+
+template <size_t Dim>
+class ChamberImpl final : public Chamber {
+    using Position = phys::Position<Dim>;
+    using Velocity = phys::Velocity<Dim>;
+
     Position m_chamberCorner;
     // std::vector<GasAtom> m_atoms;
-    BallsCollection m_atoms;
+    BallsCollection<Dim> m_atoms;
+    CellTuner m_cellTuner;
     Time m_time;
     Time m_dt = 0.01_sec;
 
@@ -22,68 +139,125 @@ class Chamber {
     static constexpr const Time max_dt = 1e4_sec;
 
     Time m_impulseMeasureStart;
-    std::array<phys::ImpulseVal, 6> m_wallImpulse;
+    std::array<phys::ImpulseVal, 2 * Dim> m_wallImpulse;
 
+    StepCounters m_counters;
 
-public:
-    enum ChamberWall {
-        Left = 0,
-        Right,
-        Top,
-        Bottom,
-        Front,
-        Back,
-    };
+    InvariantMonitor<Dim> m_monitor;
+    size_t m_invariantPeriod = 0;
+    size_t m_violations = 0;
 
-    struct Metrics {
-        Position chamberCorner;
-        std::vector<GasAtom> atoms;
-        Volume volume;
-        Vector<Energy> kineticEnergy;
-        std::array<Pressure, 2 * UniverseDim> pressure;
-        Impulse impulse;
-        ImpulseMoment impulseMoment;
-        Time time;
-    };
+    size_t m_auditPeriod = 0;
+    BroadPhaseAudit m_audit;
+    std::minstd_rand m_auditRandom;
+
+    size_t m_rdfPeriod = 0;
 
 public:
-    Chamber(Position corner = {})
-        : m_chamberCorner(corner), m_atoms(std::max(corner.X(), corner.Y()), 1_sec) {
-            m_atoms.setWalls(corner);
-            m_atoms.setCellSize(1e-9_m);
+    ChamberImpl(Corner corner = {})
+        : m_chamberCorner(toPosition(corner)), m_atoms(std::max(corner.X(), corner.Y()), 1_sec) {
+            m_atoms.setWalls(m_chamberCorner);
+            updateCellSize();
         }
 
-    void fillRandom(size_t N, VelocityVal maxV, Mass m, Length r);
+    size_t dim() const override {
+        return Dim;
+    }
 
-    void fillRandomAxis(size_t N, VelocityVal maxV, Mass m, Length r, size_t axis = 0);
+    void fillRandom(size_t N, VelocityVal maxV, Mass m, Length r) override;
 
-    void fillRandomHalf(size_t N, VelocityVal maxV, Mass m, Length r, int half);
+    void fillRandomAxis(size_t N, VelocityVal maxV, Mass m, Length r, size_t axis = 0) override;
 
+    void fillRandomHalf(size_t N, VelocityVal maxV, Mass m, Length r, int half) override;
+
+    /// Rebuilds the grid for the current walls and has the cell size re-tuned on the next step.
     void updateCellSize();
 
-    void setWalls(Position pos) {
-            m_chamberCorner = pos;
-            m_atoms.setWalls(pos);
+    void setWalls(Corner pos) override {
+            m_chamberCorner = toPosition(pos);
+            m_atoms.setWalls(m_chamberCorner);
+            updateCellSize();
     }
 
-    void step();
+    void step() override;
+
+    void getMetrics(Metrics& metrics) const override;
 
-    void getMetrics(Metrics& metrics) const;
+    const StepCounters& getCounters() const override {
+        return m_counters;
+    }
 
-    void setDT(Time dt) {
+    void setDT(Time dt) override {
         m_dt = dt;
     }
 
-    void setXLength(Length len);
+    void setXLength(Length len) override;
 
-    void openHole(bool open) {
+    void openHole(bool open) override {
         m_atoms.setEnableHole(open);
     }
 
+    void setBoundary(size_t axis, Boundary boundary) override {
+        if (axis >= Dim)
+            return;
+        m_atoms.setBoundary(axis, boundary);
+        updateCellSize();
+    }
+
+    void setPressureWindow(Time window) override;
+
+    void setHistogramPeriod(size_t steps) override {
+        m_atoms.setHistogramPeriod(steps);
+    }
+
+    void setInvariantPeriod(size_t steps) override {
+        m_invariantPeriod = steps;
+    }
+
+    void setAuditPeriod(size_t steps) override {
+        m_auditPeriod = steps;
+    }
+
+    void setContinuousCollisions(bool continuous) override {
+        m_atoms.setContinuous(continuous);
+    }
+
+    void setMsdPeriod(size_t steps) override {
+        m_atoms.setMsdPeriod(steps);
+    }
+
+    void setVacfPeriod(size_t steps) override {
+        m_atoms.setVacfPeriod(steps);
+    }
+
+    void setRdfPeriod(size_t steps) override {
+        m_rdfPeriod = steps;
+        m_atoms.resetRdf();
+    }
+
+    void setProfilePeriod(size_t steps) override {
+        m_atoms.setProfilePeriod(steps);
+    }
+
+    void setThermostat(const Thermostat& thermostat) override {
+        m_atoms.setThermostat(thermostat);
+    }
+
 private:
+    static Position toPosition(const Corner& corner) {
+        Position pos;
+        for (size_t i = 0; i < Dim; ++i) {
+            pos[i] = corner[i];
+        }
+        return pos;
+    }
+
+    void startCellTuning();
+
     bool hasCollision(size_t i, size_t j);
 
-    void handleCollision(size_t i, size_t j);
+    /// False if the pair was already parting.
+    bool handleCollision(size_t i, size_t j);
 
     void handleWallCollision(size_t i);
 };
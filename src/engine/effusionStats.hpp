@@ -0,0 +1,27 @@
+#ifndef ENGINE_EFFUSIONSTATS_HPP
+#define ENGINE_EFFUSIONSTATS_HPP
+
+#include "units.hpp"
+#include <array>
+#include <vector>
+
+namespace phys {
+
+/// Atoms that left the chamber through the hole since it was first opened.
+struct EffusionStats {
+    static const size_t EnergyBins = 32;
+
+    size_t total = 0;
+    Energy energy{}; // kinetic energy carried away
+
+    /// Escaped atoms per species id.
+    std::vector<size_t> bySpecies;
+
+    /// Escaped atoms per kinetic energy bin, the last bin also takes everything above.
+    std::array<size_t, EnergyBins> byEnergy{};
+    Energy binWidth{};
+};
+
+} // namespace phys
+
+#endif /* ENGINE_EFFUSIONSTATS_HPP */
@@ -0,0 +1,57 @@
+#include "ensemble.hpp"
+#include "parallel.hpp"
+
+#include <QMutex>
+#include <QThreadPool>
+#include <chrono>
+
+namespace phys {
+
+std::vector<EnsembleResult> runEnsemble(const std::vector<EnsembleJob>& jobs) {
+    std::vector<EnsembleResult> results(jobs.size());
+    if (jobs.empty()) {
+        return results;
+    }
+
+    // Fills draw from rand(), so chambers are built one at a time: a seed gives the same chamber
+    // whatever else runs. Each one is built in its task and freed with its result, only the
+    // running replicas are in memory.
+    QMutex buildMutex;
+
+    const size_t threads = std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    const size_t running = std::min(jobs.size(), threads);
+    const size_t tasks = std::clamp<size_t>(threads / running, 1, StepSize);
+
+    // A replica waiting for its chunks runs the ones no thread has taken yet itself
+    // (QFuture::waitForFinished), so replicas filling the pool do not wait for each other.
+    QFutureSynchronizer<void> synchronizer = {};
+    for (size_t idx = 0; idx < jobs.size(); ++idx) {
+        synchronizer.addFuture(QtConcurrent::run([&, idx] {
+            TraceScope scope("replica", static_cast<int64_t>(idx));
+            const size_t savedTasks = chunkTasks();
+            chunkTasks() = tasks;
+
+            std::unique_ptr<Chamber> chamber;
+            {
+                QMutexLocker lock(&buildMutex);
+                chamber = jobs[idx].make();
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < jobs[idx].steps; ++i) {
+                chamber->step();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            results[idx].seconds = elapsed.count();
+            results[idx].metrics.render.sampleSize = 1;
+            chamber->getMetrics(results[idx].metrics);
+            chamber.reset();
+            chunkTasks() = savedTasks;
+        }));
+    }
+    synchronizer.waitForFinished();
+    return results;
+}
+
+} // namespace phys
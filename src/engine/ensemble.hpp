@@ -0,0 +1,33 @@
+#ifndef ENGINE_ENSEMBLE_HPP
+#define ENGINE_ENSEMBLE_HPP
+
+#include "chamber.hpp"
+
+#include <functional>
+
+namespace phys {
+
+/// One independent chamber of an ensemble.
+struct EnsembleJob {
+    /// Builds the chamber in the task of the job, never two at once.
+    std::function<std::unique_ptr<Chamber>()> make;
+    size_t steps = 0;
+};
+
+struct EnsembleResult {
+    Chamber::Metrics metrics; // after the last step, with a single rendered atom
+    double seconds = 0;       // wall time of the steps
+};
+
+/**
+ * @brief Runs the jobs side by side on the global pool and returns their results in order.
+ *
+ * With R replicas running at once on P pool threads, the kernels of every replica spread their
+ * chunks over P / R tasks: a few big replicas keep the intra-chamber parallelism, a wide sweep
+ * runs one replica per thread with its chunks inline. Results do not depend on the split.
+ */
+std::vector<EnsembleResult> runEnsemble(const std::vector<EnsembleJob>& jobs);
+
+} // namespace phys
+
+#endif /* ENGINE_ENSEMBLE_HPP */
@@ -6,8 +6,14 @@
 
 namespace phys {
 
+template <size_t Dim>
 class GasAtom {
+public:
+    using Position = phys::Position<Dim>;
+    using Velocity = phys::Velocity<Dim>;
+    using Impulse = phys::Impulse<Dim>;
 
+private:
     // State characteristics
     Position m_pos;
     Velocity m_v;
@@ -74,7 +80,8 @@ public:
         m_sumE += getKinetic() * dt;
     }
 
-    ImpulseMoment getImpulseMoment() const {
+    /// Vector in 3D, scalar in 2D.
+    auto getImpulseMoment() const {
         auto impulse = m_v * m_mass;
         return CrossProd(m_pos, impulse);
     }
@@ -88,7 +95,7 @@ public:
         return e;
     }
 
-    Vector<Energy> getKineticDistributed() const {
+    Vector<Energy, Dim> getKineticDistributed() const {
         return MulByElement(m_v, m_v) * m_mass /= 2.l;
     }
 
@@ -0,0 +1,101 @@
+#include "invariantMonitor.hpp"
+
+#include <iostream>
+
+namespace phys {
+
+const char* invariantName(Invariant invariant) {
+    switch (invariant) {
+    case Invariant::EnergyDrift:
+        return "energy";
+    case Invariant::MomentumDrift:
+        return "momentum";
+    case Invariant::OutsideWalls:
+        return "outside walls";
+    case Invariant::Overlap:
+        return "overlap";
+    }
+    return "unknown";
+}
+
+template <size_t Dim>
+void InvariantMonitor<Dim>::report(Invariant invariant, size_t step, size_t atom, size_t other, num_t value) {
+    std::cerr << "Invariant violated at step " << step << ": " << invariantName(invariant);
+    if (atom != SIZE_MAX) {
+        std::cerr << ", atom " << atom;
+    }
+    if (other != SIZE_MAX) {
+        std::cerr << ", atom " << other;
+    }
+    std::cerr << ", " << value << '\n';
+}
+
+template <size_t Dim>
+size_t InvariantMonitor<Dim>::check(const BallsCollection<Dim>& atoms, size_t step) {
+    size_t violations = 0;
+    const size_t n = atoms.size();
+
+    // The thermostat changes both, the heat it gave is taken out of the energy.
+    const bool thermostat = atoms.getThermostat().mode != ThermostatMode::Off;
+    const num_t energy = *Trace(atoms.getKineticDistributed()) + *atoms.getEffusionStats().energy -
+                         *atoms.getThermostatStats().heat;
+    const Impulse<Dim> momentum = atoms.getMomentum();
+    const size_t escaped = atoms.getEffusionStats().total;
+    const size_t kept = n + escaped;
+    if (m_valid && kept == m_atoms) {
+        const num_t drift = std::abs(energy - m_energy) / std::max(std::abs(m_energy), num_t{1e-300});
+        if (drift > num_t{Tolerance}) {
+            report(Invariant::EnergyDrift, step, SIZE_MAX, SIZE_MAX, drift);
+            violations++;
+        }
+
+        // Only the periodic axes keep their momentum, walls take it in every step.
+        const num_t scale = std::max(*m_momentum.Len(), *momentum.Len());
+        for (size_t d = 0; d < Dim; ++d) {
+            if (atoms.getBoundary(d) != Boundary::Periodic || escaped != m_escaped || thermostat || !(scale > num_t{0}))
+                continue;
+            const num_t change = std::abs(*(momentum[d] - m_momentum[d])) / scale;
+            if (change > num_t{Tolerance}) {
+                report(Invariant::MomentumDrift, step, SIZE_MAX, SIZE_MAX, change);
+                violations++;
+            }
+        }
+    }
+    m_valid = true;
+    m_atoms = kept;
+    m_escaped = escaped;
+    m_energy = energy;
+    m_momentum = momentum;
+
+    for (size_t k = 0; k < SampleSize && n != 0; ++k) {
+        const size_t i = m_random() % n;
+        const auto pos = atoms.getAtom(i).getPos();
+        for (size_t d = 0; d < Dim; ++d) {
+            if (pos[d] < Length{0} || pos[d] > atoms.getWall(d)) {
+                report(Invariant::OutsideWalls, step, i, SIZE_MAX, *pos[d]);
+                violations++;
+                break;
+            }
+        }
+    }
+
+    const auto& collisions = atoms.getCollisions();
+    for (size_t k = 0; k < SampleSize && !collisions.empty(); ++k) {
+        const auto [i, j] = collisions[m_random() % collisions.size()];
+        if (i >= n || j >= n)
+            continue;
+        const auto separation = atoms.getSeparation(j, i);
+        const Length contact = atoms.getContact(atoms.getSpeciesId(i), atoms.getSpeciesId(j));
+        const auto approach = (atoms.getAtom(i).getVelocity() - atoms.getAtom(j).getVelocity(), separation);
+        if (separation.Len2() < contact * contact && *approach > num_t{0}) {
+            report(Invariant::Overlap, step, i, j, *(separation.Len() / contact));
+            violations++;
+        }
+    }
+    return violations;
+}
+
+template class InvariantMonitor<2>;
+template class InvariantMonitor<3>;
+
+} // namespace phys
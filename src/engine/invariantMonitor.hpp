@@ -0,0 +1,50 @@
+#ifndef ENGINE_INVARIANTMONITOR_HPP
+#define ENGINE_INVARIANTMONITOR_HPP
+
+#include "ballsCollection.hpp"
+
+#include <random>
+
+namespace phys {
+
+enum class Invariant : uint8_t {
+    EnergyDrift = 0,   // kinetic energy plus the energy carried out through the hole changed
+    MomentumDrift = 1, // momentum along a periodic axis changed
+    OutsideWalls = 2,  // atom outside the chamber after the wall step
+    Overlap = 3,       // overlapping pair still approaching after the collision step
+};
+
+const char* invariantName(Invariant invariant);
+
+/**
+ * @brief Checks that a run still conserves what it should, cheap enough for production runs.
+ *
+ * Energy and momentum are compared with the previous check, so a slow drift is reported as
+ * it builds up. Atoms added in between make the check start over. Walls and overlaps are checked for SampleSize random atoms and collision
+ * pairs only. A check costs about two passes over the atoms.
+ */
+template <size_t Dim>
+class InvariantMonitor {
+public:
+    static const size_t SampleSize = 64;
+
+    /// Relative change of energy or momentum between two checks that is still rounding.
+    static constexpr double Tolerance = 1e-6;
+
+    /// Checks the atoms after a step, reports violations to std::cerr and returns their count.
+    size_t check(const BallsCollection<Dim>& atoms, size_t step);
+
+private:
+    void report(Invariant invariant, size_t step, size_t atom, size_t other, num_t value);
+
+    bool m_valid = false;
+    size_t m_atoms = 0;   // with the escaped ones
+    size_t m_escaped = 0;
+    num_t m_energy = 0;  // J, with the escaped energy
+    Impulse<Dim> m_momentum;
+    std::minstd_rand m_random;
+};
+
+} // namespace phys
+
+#endif /* ENGINE_INVARIANTMONITOR_HPP */
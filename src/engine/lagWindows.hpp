@@ -0,0 +1,87 @@
+#ifndef ENGINE_LAGWINDOWS_HPP
+#define ENGINE_LAGWINDOWS_HPP
+
+#include "units.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace phys {
+
+/**
+ * @brief Time origins of a multiple-tau correlator over levels of growing lag.
+ *
+ * Level l takes a sample every Lags^l sampling periods and keeps its last Lags samples as
+ * origins in a ring. A sample is correlated with every stored origin, the k-th previous one
+ * going to lag k, so every sample feeds every lag of its level. The memory is Lags per-atom
+ * origins per level whatever the run length.
+ */
+class LagWindows {
+public:
+    static const size_t Levels = 4;
+    static const size_t Lags = 16;
+
+    /// Forgets the origins, the next samples store them again.
+    void restart() {
+        m_head = {};
+        m_stored = {};
+        m_samples = 0;
+    }
+
+    /// Levels that take the next sample, as a bit mask.
+    uint32_t levels() const {
+        uint32_t mask = 0;
+        size_t period = 1;
+        for (size_t level = 0; level < Levels; ++level) {
+            if (m_samples % period == 0) {
+                mask |= 1u << level;
+            }
+            period *= Lags;
+        }
+        return mask;
+    }
+
+    /// Origins the next sample of the level is correlated with, at lags 0..origins() - 1.
+    size_t origins(size_t level) const {
+        return m_stored[level];
+    }
+
+    /// Ring slot of the origin of a lag index, lag + 1 samples of the level before the next one.
+    size_t slot(size_t level, size_t lag) const {
+        return (m_head[level] + Lags - 1 - lag) % Lags;
+    }
+
+    /// Ring slot the next sample of the level is stored in, over the oldest origin.
+    size_t nextSlot(size_t level) const {
+        return m_head[level];
+    }
+
+    /// Stores the sample of the levels of the mask.
+    void advance(uint32_t levels) {
+        for (size_t level = 0; level < Levels; ++level) {
+            if (!(levels & (1u << level)))
+                continue;
+            m_head[level] = (m_head[level] + 1) % Lags;
+            m_stored[level] = std::min(m_stored[level] + 1, Lags);
+        }
+        m_samples++;
+    }
+
+    /// Time of a lag index of the level when level 0 is sampled every sampleTime.
+    static Time lagTime(Time sampleTime, size_t level, size_t lag) {
+        size_t period = 1;
+        for (size_t l = 0; l < level; ++l) {
+            period *= Lags;
+        }
+        return sampleTime * num_t{period * (lag + 1)};
+    }
+
+private:
+    std::array<size_t, Levels> m_head = {};
+    std::array<size_t, Levels> m_stored = {};
+    size_t m_samples = 0; // of level 0 since the restart
+};
+
+} // namespace phys
+
+#endif /* ENGINE_LAGWINDOWS_HPP */
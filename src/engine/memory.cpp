@@ -0,0 +1,111 @@
+#include "memory.hpp"
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <set>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace phys {
+
+static const size_t CacheLine = 64;
+static const size_t HugePage = 2 << 20;
+
+static std::atomic<size_t> allocationCount = 0;
+static std::atomic<size_t> allocatedBytes = 0;
+static std::atomic<bool> hugePages = false;
+
+// Buffers aligned to a huge page, the flag may change before they are freed. Never destroyed,
+// columns of static objects may be freed after it.
+static QMutex hugeMutex;
+
+static std::set<void*>& hugeBuffers() {
+    static std::set<void*>* buffers = new std::set<void*>;
+    return *buffers;
+}
+
+static void countAllocation(size_t bytes) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+AllocationStats getAllocationStats() {
+    return {allocationCount.load(std::memory_order_relaxed), allocatedBytes.load(std::memory_order_relaxed)};
+}
+
+void setHugePages(bool enable) {
+    hugePages = enable;
+}
+
+void* allocateAligned(size_t bytes) {
+#ifndef PHYS_COUNT_NEW
+    countAllocation(bytes);
+#endif
+
+    if (!hugePages || bytes < HugePage) {
+        return ::operator new(bytes, std::align_val_t{CacheLine});
+    }
+
+    void* ptr = ::operator new(bytes, std::align_val_t{HugePage});
+#ifdef __linux__
+    madvise(ptr, bytes / HugePage * HugePage, MADV_HUGEPAGE);
+#endif
+    QMutexLocker<QMutex> locker(&hugeMutex);
+    hugeBuffers().insert(ptr);
+    return ptr;
+}
+
+void freeAligned(void* ptr, size_t bytes) {
+    size_t alignment = CacheLine;
+    if (ptr != nullptr && bytes >= HugePage) {
+        QMutexLocker<QMutex> locker(&hugeMutex);
+        if (hugeBuffers().erase(ptr) != 0) {
+            alignment = HugePage;
+        }
+    }
+    ::operator delete(ptr, std::align_val_t{alignment});
+}
+
+} // namespace phys
+
+#ifdef PHYS_COUNT_NEW
+// Every heap allocation of the process is counted, the tasks Qt allocates for a step included.
+
+void* operator new(size_t bytes) {
+    phys::countAllocation(bytes);
+    if (void* ptr = std::malloc(bytes != 0 ? bytes : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new(size_t bytes, std::align_val_t alignment) {
+    phys::countAllocation(bytes);
+    const size_t align = static_cast<size_t>(alignment);
+    if (void* ptr = std::aligned_alloc(align, (std::max<size_t>(bytes, 1) + align - 1) / align * align)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+#endif
@@ -0,0 +1,32 @@
+#ifndef ENGINE_MEMORY_HPP
+#define ENGINE_MEMORY_HPP
+
+#include <cstddef>
+
+namespace phys {
+
+/**
+ * @brief Heap traffic since start.
+ *
+ * Counts the engine buffers of allocateAligned(), sized once so that a steady step adds none.
+ * Built with PHYS_COUNT_NEW it counts every operator new of the process instead, the tasks
+ * parallelChunks() submits and the other threads included.
+ */
+struct AllocationStats {
+    size_t count = 0;
+    size_t bytes = 0;
+};
+
+AllocationStats getAllocationStats();
+
+/// Buffers of at least 2 MiB allocated from now on ask the kernel for transparent huge pages.
+void setHugePages(bool enable);
+
+/// 64 byte aligned storage, buffers of 2 MiB and more are 2 MiB aligned while huge pages are on.
+void* allocateAligned(size_t bytes);
+
+void freeAligned(void* ptr, size_t bytes);
+
+} // namespace phys
+
+#endif /* ENGINE_MEMORY_HPP */
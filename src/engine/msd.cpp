@@ -0,0 +1,63 @@
+#include "msd.hpp"
+#include <algorithm>
+
+namespace phys {
+
+num_t MsdStats::Series::msd(size_t level, size_t lag, const std::array<bool, MaxDim>& free) const {
+    if (count[level][lag] == 0)
+        return 0;
+    num_t total = 0;
+    for (size_t d = 0; d < MaxDim; ++d) {
+        if (free[d]) {
+            total += sum[level][lag][d];
+        }
+    }
+    return total / num_t{count[level][lag]};
+}
+
+Time MsdStats::lagTime(size_t level, size_t lag) const {
+    return LagWindows::lagTime(sampleTime, level, lag);
+}
+
+void fitDiffusion(MsdStats& stats) {
+    const size_t axes = static_cast<size_t>(std::count(stats.free.begin(), stats.free.end(), true));
+
+    for (auto& series : stats.species) {
+        series.diffusion = 0;
+        if (axes == 0 || !(*stats.sampleTime > num_t{0}))
+            continue;
+
+        num_t longest = 0;
+        for (size_t level = 0; level < MsdStats::Levels; ++level) {
+            for (size_t lag = 0; lag < MsdStats::Lags; ++lag) {
+                if (series.count[level][lag] != 0) {
+                    longest = std::max(longest, *stats.lagTime(level, lag));
+                }
+            }
+        }
+
+        // Least squares over the points of the longest span, in seconds and m^2.
+        const num_t from = longest / num_t{MsdStats::Lags};
+        num_t n = 0, st = 0, sm = 0, stt = 0, stm = 0;
+        for (size_t level = 0; level < MsdStats::Levels; ++level) {
+            for (size_t lag = 0; lag < MsdStats::Lags; ++lag) {
+                const num_t t = *stats.lagTime(level, lag);
+                if (series.count[level][lag] == 0 || t < from)
+                    continue;
+                const num_t m = series.msd(level, lag, stats.free);
+                n += 1;
+                st += t;
+                sm += m;
+                stt += t * t;
+                stm += t * m;
+            }
+        }
+
+        const num_t det = n * stt - st * st;
+        if (n < num_t{3} || !(det > num_t{0}))
+            continue;
+        series.diffusion = (n * stm - st * sm) / det / num_t{2 * axes};
+    }
+}
+
+} // namespace phys
@@ -0,0 +1,55 @@
+#ifndef ENGINE_MSD_HPP
+#define ENGINE_MSD_HPP
+
+#include "lagWindows.hpp"
+#include <array>
+#include <vector>
+
+namespace phys {
+
+/**
+ * @brief Mean squared displacement of every species over the lags of LagWindows.
+ *
+ * A sample costs O(Lags N) amortized over the levels. Displacements are unfolded: periodic
+ * crossings are undone and wall reflections mirrored back, as if the atom flew on through an
+ * image of the chamber, so walled axes diffuse like periodic ones.
+ */
+struct MsdStats {
+    static const size_t Levels = LagWindows::Levels;
+    static const size_t Lags = LagWindows::Lags;
+
+    struct Series {
+        /// Squared displacements summed over atoms and origins, m^2.
+        std::array<std::array<std::array<num_t, MaxDim>, Lags>, Levels> sum{};
+        /// Atoms summed into every lag.
+        std::array<std::array<size_t, Lags>, Levels> count{};
+
+        /// Self-diffusion coefficient over the free axes, m^2/s, 0 until there are enough lags.
+        num_t diffusion = 0;
+
+        /// Mean squared displacement along the free axes, m^2, 0 without samples.
+        num_t msd(size_t level, size_t lag, const std::array<bool, MaxDim>& free) const;
+    };
+
+    size_t dim = MaxDim;
+    Time sampleTime{}; // period of level 0
+
+    /// Axes the MSD is summed over, every axis of the chamber.
+    std::array<bool, MaxDim> free{};
+
+    std::vector<Series> species; // by species id
+
+    /// Lag of a point of the level, lag from 0.
+    Time lagTime(size_t level, size_t lag) const;
+};
+
+/**
+ * @brief Fits MSD = 2 n D t + c over the longest Lags-fold span of lags of every species.
+ *
+ * The intercept takes up the ballistic start, n is the number of free axes.
+ */
+void fitDiffusion(MsdStats& stats);
+
+} // namespace phys
+
+#endif /* ENGINE_MSD_HPP */
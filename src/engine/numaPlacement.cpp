@@ -0,0 +1,62 @@
+#include "numaPlacement.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+
+#ifdef PHYS_HAVE_NUMA
+#include <numa.h>
+#endif
+
+namespace phys {
+
+size_t numaNodes() {
+#ifdef PHYS_HAVE_NUMA
+    static const size_t nodes = numa_available() < 0 ? 1 : std::max(1, numa_num_configured_nodes());
+    return nodes;
+#else
+    return 1;
+#endif
+}
+
+size_t chunkNode(size_t chunkIdx) {
+    return chunkIdx * numaNodes() / StepSize;
+}
+
+QThreadPool* nodePool(size_t node) {
+    if (numaNodes() == 1)
+        return nullptr;
+
+    // Never freed: workers may still be parked when static destructors run.
+    static const std::vector<QThreadPool*> pools = [] {
+        std::vector<QThreadPool*> made;
+        const int share = std::max(1, QThreadPool::globalInstance()->maxThreadCount() / static_cast<int>(numaNodes()));
+        for (size_t n = 0; n < numaNodes(); ++n) {
+            int threads = share;
+#ifdef PHYS_HAVE_NUMA
+            bitmask* cpus = numa_allocate_cpumask();
+            if (numa_node_to_cpus(static_cast<int>(n), cpus) == 0 && numa_bitmask_weight(cpus) != 0) {
+                threads = static_cast<int>(numa_bitmask_weight(cpus));
+            }
+            numa_free_cpumask(cpus);
+#endif
+            made.push_back(new QThreadPool);
+            made.back()->setMaxThreadCount(threads);
+        }
+        return made;
+    }();
+    return pools[node];
+}
+
+void bindToNode(size_t node) {
+#ifdef PHYS_HAVE_NUMA
+    // A worker of a node pool only ever runs chunks of its node, so it moves once.
+    static thread_local bool bound = false;
+    if (!bound) {
+        numa_run_on_node(static_cast<int>(node));
+        bound = true;
+    }
+#else
+    (void)node;
+#endif
+}
+
+} // namespace phys
@@ -0,0 +1,69 @@
+#ifndef ENGINE_NUMAPLACEMENT_HPP
+#define ENGINE_NUMAPLACEMENT_HPP
+
+#include "memory.hpp"
+#include <QThreadPool>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace phys {
+
+/// NUMA nodes the kernels spread their chunks over, 1 without libnuma.
+size_t numaNodes();
+
+/// Node that chunk chunkIdx of a kernel runs on and keeps its part of the columns in.
+size_t chunkNode(size_t chunkIdx);
+
+/// Pool of workers that run on the node only, nullptr on a single node.
+QThreadPool* nodePool(size_t node);
+
+/// Moves the calling worker of nodePool(node) onto the CPUs of the node, once per thread.
+void bindToNode(size_t node);
+
+/**
+ * @brief Allocator that leaves trivial elements unconstructed.
+ *
+ * Resizing a column then does not touch its pages, so the first write, done by the chunk
+ * workers in firstTouch(), decides the node each page lands on.
+ */
+template <typename T>
+struct FirstTouchAllocator {
+    using value_type = T;
+
+    FirstTouchAllocator() = default;
+
+    template <typename U>
+    FirstTouchAllocator(const FirstTouchAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(allocateAligned(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        freeAligned(p, n * sizeof(T));
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        if constexpr (sizeof...(Args) == 0 && std::is_trivially_copyable_v<U> && std::is_trivially_destructible_v<U>) {
+            return;
+        } else {
+            std::construct_at(p, std::forward<Args>(args)...);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const FirstTouchAllocator<U>&) const {
+        return true;
+    }
+};
+
+/// Per-atom column, 64 byte aligned and placed by the chunk that works on it.
+template <typename T>
+using Column = std::vector<T, FirstTouchAllocator<T>>;
+
+} // namespace phys
+
+#endif /* ENGINE_NUMAPLACEMENT_HPP */
@@ -0,0 +1,89 @@
+#ifndef ENGINE_PARALLEL_HPP
+#define ENGINE_PARALLEL_HPP
+
+#include "numaPlacement.hpp"
+#include "trace.hpp"
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+
+namespace phys {
+
+/// Number of chunks the parallel kernels split their ranges into.
+static const size_t StepSize = 16;
+
+/**
+ * @brief Pool tasks the kernels started by the calling thread spread their chunks over.
+ *
+ * StepSize by default. Replicas of an ensemble lower it, so several chambers share the pool
+ * instead of each of them taking all of it; 1 runs every chunk in the calling thread.
+ */
+inline size_t& chunkTasks() {
+    thread_local size_t tasks = StepSize;
+    return tasks;
+}
+
+/**
+ * @brief Splits [0, n) into at most StepSize chunks and runs func(chunkIdx, begin, end) for
+ * each of them on the global pool.
+ *
+ * On several NUMA nodes every chunk runs in the pool of chunkNode(chunkIdx), whose workers
+ * stay on that node, so a kernel reads the part of a column that firstTouch() placed there.
+ * Chunks are the same for any chunkTasks(), a task runs neighbouring chunks of one node;
+ * inline chunks stay on the caller's node. Every chunk is traced as a span named span.
+ */
+template <typename F>
+void parallelChunks(size_t n, F func, const char* span = "chunk") {
+    const size_t chunk = std::max<size_t>(1, (n + StepSize - 1) / StepSize);
+    const size_t chunks = (n + chunk - 1) / chunk;
+    const size_t tasks = std::min(chunks, chunkTasks());
+
+    auto runChunks = [&func, n, chunk, span] (size_t first, size_t last, QThreadPool* pool, size_t node) {
+        if (pool != nullptr) {
+            bindToNode(node);
+        }
+        for (size_t idx = first; idx < last; ++idx) {
+            TraceScope scope(span, static_cast<int64_t>(idx));
+            func(idx, idx * chunk, std::min(n, (idx + 1) * chunk));
+        }
+    };
+    if (tasks <= 1) {
+        runChunks(0, chunks, nullptr, 0);
+        return;
+    }
+
+    QFutureSynchronizer<void> synchronizer = {};
+    for (size_t task = 0; task < tasks; ++task) {
+        const size_t last = (task + 1) * chunks / tasks;
+        // A task that reaches over a node border is split there.
+        for (size_t first = task * chunks / tasks, end = first; first < last; first = end) {
+            const size_t node = chunkNode(first);
+            while (end < last && chunkNode(end) == node) {
+                ++end;
+            }
+            QThreadPool* pool = nodePool(node);
+            synchronizer.addFuture(pool != nullptr ? QtConcurrent::run(pool, runChunks, first, end, pool, node)
+                                                   : QtConcurrent::run(runChunks, first, end, pool, node));
+        }
+    }
+    synchronizer.waitForFinished();
+}
+
+/**
+ * @brief Moves the column into fresh storage of n elements written chunk by chunk by the
+ * workers of parallelChunks(n, ...), elements past the old size are value-initialized.
+ */
+template <typename T>
+void firstTouch(Column<T>& column, size_t n) {
+    Column<T> placed;
+    placed.resize(n);
+    parallelChunks(n, [&column, &placed] (size_t, size_t l, size_t r) {
+        for (size_t i = l; i < r; ++i) {
+            placed[i] = i < column.size() ? column[i] : T{};
+        }
+    });
+    column.swap(placed);
+}
+
+} // namespace phys
+
+#endif /* ENGINE_PARALLEL_HPP */
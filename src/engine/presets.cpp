@@ -0,0 +1,57 @@
+#include "presets.hpp"
+#include "physconstants.hpp"
+
+#include <cstdlib>
+
+namespace phys {
+
+static const Length XSize = 5e-7_m;
+static const Length YSize = 5e-7_m;
+static const Length ZSize = 1e-7_m;
+
+const char* presetName(Preset preset) {
+    switch (preset) {
+    case Preset::Axis:
+        return "axis";
+    case Preset::Random:
+        return "random";
+    case Preset::TwoGases:
+        return "twoGases";
+    }
+    return "unknown";
+}
+
+Chamber::Corner presetCorner(Preset preset, size_t dim) {
+    num_t downscale = preset == Preset::TwoGases && dim == 3 ? 0.05 : 1.;
+    return {XSize * downscale, YSize * downscale, ZSize * downscale};
+}
+
+size_t presetAtoms(Preset preset) {
+    return preset == Preset::TwoGases ? 105'000 : 100'000;
+}
+
+std::unique_ptr<Chamber> makePreset(Preset preset, size_t dim, size_t nAtoms, unsigned seed,
+                                    num_t lengthScale, num_t speedScale) {
+    Chamber::Corner corner = presetCorner(preset, dim);
+    corner[0] *= lengthScale;
+    std::unique_ptr<Chamber> chamber = Chamber::create(dim, corner);
+    chamber->setDT(PresetStep);
+    srand(seed);
+
+    switch (preset) {
+    case Preset::Axis:
+        chamber->fillRandomAxis(nAtoms, speedScale * 1e3_m / 1_sec, num_t{4} * consts::Dalton, 31e-12_m);
+        break;
+    case Preset::Random:
+        chamber->fillRandom(nAtoms, speedScale * 4e3_m / 1_sec, num_t{4} * consts::Dalton, 31e-12_m);
+        break;
+    case Preset::TwoGases:
+        // 180 kPa 1.1 MPa
+        chamber->fillRandomHalf(nAtoms / 2, speedScale * 5e3_m / 1_sec, num_t{4}   * consts::Dalton, 31e-12_m, 0);
+        chamber->fillRandomHalf(nAtoms - nAtoms / 2, speedScale * 3e2_m / 1_sec, num_t{131} * consts::Dalton, 108e-12_m, 1);
+        break;
+    }
+    return chamber;
+}
+
+} // namespace phys
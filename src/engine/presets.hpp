@@ -0,0 +1,42 @@
+#ifndef ENGINE_PRESETS_HPP
+#define ENGINE_PRESETS_HPP
+
+#include "chamber.hpp"
+
+#include <memory>
+
+namespace phys {
+
+/// Scenarios of the GUI, also run by the benchmark.
+enum class Preset : uint8_t {
+    Axis = 0,     // helium moving along X only
+    Random = 1,   // helium in the whole chamber
+    TwoGases = 2, // hot helium and cold xenon in the two halves of a small chamber
+};
+
+const size_t PresetCount = 3;
+
+constexpr const Time PresetStep = 5e-14_sec;
+
+const char* presetName(Preset preset);
+
+/// Walls of the preset, the last component is dropped in 2D.
+Chamber::Corner presetCorner(Preset preset, size_t dim);
+
+/// Atom count the GUI runs the preset with.
+size_t presetAtoms(Preset preset);
+
+/**
+ * @brief Chamber of the preset with dt set to PresetStep.
+ *
+ * @param nAtoms - atoms in the chamber, split evenly between the gases of TwoGases
+ * @param seed - seed of rand() the atoms are placed with, equal seeds give equal chambers
+ * @param lengthScale - factor of the X length of the chamber, the atoms fill all of it
+ * @param speedScale - factor of the initial speeds, the temperature goes as its square
+ */
+std::unique_ptr<Chamber> makePreset(Preset preset, size_t dim, size_t nAtoms, unsigned seed = 1,
+                                    num_t lengthScale = 1, num_t speedScale = 1);
+
+} // namespace phys
+
+#endif /* ENGINE_PRESETS_HPP */
@@ -0,0 +1,20 @@
+#include "profile.hpp"
+
+namespace phys {
+
+void writeJson(std::ostream& out, const ConcentrationProfile& profile) {
+    out << "{\"step\":" << profile.step << ",\"time\":" << *profile.time
+        << ",\"slabWidth\":" << *profile.slabWidth << ",\"species\":[";
+    for (size_t id = 0; id < profile.atoms.size(); ++id) {
+        out << (id ? "," : "") << "{\"atoms\":[";
+        for (size_t slab = 0; slab < ConcentrationProfile::Slabs; ++slab) {
+            out << (slab ? "," : "") << profile.atoms[id][slab];
+        }
+        out << "],\"crossed\":" << profile.crossed[id]
+            << ",\"gradient\":" << profile.gradient[id]
+            << ",\"diffusion\":" << profile.diffusion[id] << '}';
+    }
+    out << "]}\n";
+}
+
+} // namespace phys
@@ -0,0 +1,44 @@
+#ifndef ENGINE_PROFILE_HPP
+#define ENGINE_PROFILE_HPP
+
+#include "units.hpp"
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace phys {
+
+/**
+ * @brief Species concentration in slabs along X and the flux through the mid-plane.
+ *
+ * Meant for the two halves setup: D comes from Fick's first law J = -D dn/dx at the
+ * mid-plane, fitted through the origin over all samples. J is the net count of atoms crossing
+ * the plane between samples, dn/dx the slope of the density over the middle half of the slabs.
+ */
+struct ConcentrationProfile {
+    static const size_t Slabs = 32;
+
+    size_t dim = MaxDim;
+    size_t step = 0;  // step of the last sample
+    Time time{};      // since the profile was turned on
+    Length slabWidth{};
+
+    std::vector<std::array<size_t, Slabs>> atoms; // [species][slab] at the last sample
+
+    /// Net atoms of every species that crossed the mid-plane towards +X since the profile was turned on.
+    std::vector<int64_t> crossed;
+
+    /// Density gradient at the mid-plane at the last sample, m^-(dim+1).
+    std::vector<num_t> gradient;
+
+    /// Fick's law fit of every species, m^2/s, 0 until there are two samples.
+    std::vector<num_t> diffusion;
+};
+
+/// Writes the profile as one line of JSON.
+void writeJson(std::ostream& out, const ConcentrationProfile& profile);
+
+} // namespace phys
+
+#endif /* ENGINE_PROFILE_HPP */
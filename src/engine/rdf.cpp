@@ -0,0 +1,23 @@
+#include "rdf.hpp"
+#include <cmath>
+#include <numbers>
+
+namespace phys {
+
+void normalizePairs(PairDistribution& rdf) {
+    rdf.g.fill(0);
+    if (rdf.samples == 0 || !(rdf.ideal > num_t{0}))
+        return;
+
+    // Shell volumes in units of range^dim.
+    const double ball = rdf.dim == 2 ? std::numbers::pi : 4 * std::numbers::pi / 3;
+    const double dim = static_cast<double>(rdf.dim);
+    for (size_t bin = 0; bin < PairDistribution::Bins; ++bin) {
+        const double inner = static_cast<double>(bin) / PairDistribution::Bins;
+        const double outer = static_cast<double>(bin + 1) / PairDistribution::Bins;
+        const double shell = ball * (std::pow(outer, dim) - std::pow(inner, dim));
+        rdf.g[bin] = num_t{rdf.pairs[bin]} / (rdf.ideal * num_t{shell});
+    }
+}
+
+} // namespace phys
@@ -0,0 +1,36 @@
+#ifndef ENGINE_RDF_HPP
+#define ENGINE_RDF_HPP
+
+#include "units.hpp"
+#include <array>
+
+namespace phys {
+
+/**
+ * @brief Radial distribution function g(r) of all atoms, summed over samples.
+ *
+ * Pairs come from the cell grid of the collision step, so r reaches a few cell widths.
+ * Walls leave atoms near them with fewer neighbours, so g falls short of 1 by about the share
+ * of the volume within r of a wall; periodic sides do not.
+ */
+struct PairDistribution {
+    static const size_t Bins = 128;
+
+    size_t dim = MaxDim;
+    size_t samples = 0;
+    Length range{}; // end of the last bin
+
+    std::array<size_t, Bins> pairs{}; // pairs at distances of the bin, summed over samples
+
+    /// Pairs an ideal gas puts in a bin per unit of its volume, N (N - 1) / 2V summed over samples.
+    num_t ideal = 0; // scaled by range^dim
+
+    std::array<num_t, Bins> g{};
+};
+
+/// Fills g from the pair counts, 0 for an empty distribution.
+void normalizePairs(PairDistribution& rdf);
+
+} // namespace phys
+
+#endif /* ENGINE_RDF_HPP */
@@ -0,0 +1,39 @@
+#include "renderBuffer.hpp"
+#include "parallel.hpp"
+
+namespace phys {
+
+void sortByDepth(Column<RenderAtom>& atoms, Column<RenderAtom>& buffer) {
+    const size_t n = atoms.size();
+    buffer.resize(n);
+
+    for (uint32_t shift = 0; shift < 16; shift += 8) {
+        std::array<std::array<size_t, 256>, StepSize> offsets = {};
+        parallelChunks(n, [&atoms, &offsets, shift] (size_t chunk, size_t l, size_t r) {
+            for (size_t i = l; i < r; ++i) {
+                offsets[chunk][(atoms[i].pos[2] >> shift) & 0xff]++;
+            }
+        }, "renderChunk");
+
+        // Chunk-major order inside every digit keeps the sort stable.
+        size_t sum = 0;
+        for (size_t digit = 0; digit < 256; ++digit) {
+            for (auto& counts : offsets) {
+                size_t count = counts[digit];
+                counts[digit] = sum;
+                sum += count;
+            }
+        }
+
+        parallelChunks(n, [&atoms, &buffer, &offsets, shift] (size_t chunk, size_t l, size_t r) {
+            auto& counts = offsets[chunk];
+            for (size_t i = l; i < r; ++i) {
+                buffer[counts[(atoms[i].pos[2] >> shift) & 0xff]++] = atoms[i];
+            }
+        }, "renderChunk");
+
+        atoms.swap(buffer);
+    }
+}
+
+} // namespace phys
@@ -0,0 +1,63 @@
+#ifndef ENGINE_RENDERBUFFER_HPP
+#define ENGINE_RENDERBUFFER_HPP
+
+#include "numaPlacement.hpp"
+#include "units.hpp"
+#include <array>
+#include <cstdint>
+
+namespace phys {
+
+/**
+ * @brief Packed atom as the GUI sees it.
+ *
+ * Coordinates are quantized to the chamber walls (0 is the wall at the origin, RenderQuantMax
+ * is the opposite one), radius is quantized like the X coordinate and saturated.
+ */
+struct RenderAtom {
+    std::array<uint16_t, 3> pos;
+    uint8_t color;
+    uint8_t radius;
+};
+
+static_assert(sizeof(RenderAtom) == 8);
+
+constexpr const uint32_t RenderQuantMax = 0xffff;
+
+/// Kinetic energy of one step of the heat color key.
+constexpr const EnergyVal RenderHeatQuantum = EnergyVal{5e-23};
+
+enum class RenderKey : uint8_t {
+    Heat = 0, // color = kinetic energy in RenderHeatQuantum, saturated
+    Species = 1, // color = species id
+};
+
+/// Per-bin quantity of the binned field view. Atoms are not packed while a field is requested.
+enum class FieldKind : uint8_t {
+    None = 0,
+    Density = 1, // atoms per bin
+    Kinetic = 2, // mean kinetic energy in the bin, J
+    Species = 3, // share of the heavy species: (<m> - m_min) / (m_max - m_min)
+};
+
+struct RenderOptions {
+    RenderKey key = RenderKey::Heat;
+    size_t sampleSize = 0; // 0 means every atom
+    size_t followIdx = 0;
+    bool depthSorted = false; // atoms come back ordered by Z, far (small Z) first
+
+    FieldKind field = FieldKind::None;
+    std::array<size_t, 2> fieldSize = {0, 0}; // bins along X and Y
+};
+
+/**
+ * @brief Stable parallel radix sort of the atoms by quantized Z.
+ *
+ * @param atoms - atoms to sort, sorted in place
+ * @param buffer - scratch space, resized to atoms.size()
+ */
+void sortByDepth(Column<RenderAtom>& atoms, Column<RenderAtom>& buffer);
+
+} // namespace phys
+
+#endif /* ENGINE_RENDERBUFFER_HPP */
@@ -0,0 +1,29 @@
+#ifndef ENGINE_SPECIES_HPP
+#define ENGINE_SPECIES_HPP
+
+#include "units.hpp"
+#include <cstdint>
+
+namespace phys {
+
+/// Atoms refer to their species by a 1 byte id.
+using SpeciesId = uint8_t;
+
+constexpr const size_t MaxSpecies = 256;
+
+struct Species {
+    Mass mass;
+    Length radius;
+};
+
+/// State of one species of the gas, from the kinetic energy of its atoms.
+struct SpeciesMetrics {
+    Species species;
+    size_t count = 0;
+    Temperature temperature{};
+    num_t pressure = 0; // partial pressure 2 E / (D V), Pa in 3D and N/m in 2D
+};
+
+} // namespace phys
+
+#endif /* ENGINE_SPECIES_HPP */
@@ -0,0 +1,37 @@
+#include "stepCounters.hpp"
+
+namespace phys {
+
+const char* phaseName(StepPhase phase) {
+    switch (phase) {
+    case StepPhase::Move:
+        return "move";
+    case StepPhase::Walls:
+        return "walls";
+    case StepPhase::BroadPhase:
+        return "broadPhase";
+    case StepPhase::Resolve:
+        return "resolve";
+    }
+    return "unknown";
+}
+
+void writeJson(std::ostream& out, const StepCounters& counters) {
+    out << "{\"step\":" << counters.step << ",\"phaseSeconds\":{";
+    for (size_t phase = 0; phase < StepPhases; ++phase) {
+        out << (phase ? "," : "") << '"' << phaseName(static_cast<StepPhase>(phase)) << "\":"
+            << counters.phaseSeconds[phase];
+    }
+    out << "},\"pairsTested\":" << counters.pairsTested
+        << ",\"collisionsFound\":" << counters.collisionsFound
+        << ",\"collisionsResolved\":" << counters.collisionsResolved
+        << ",\"deleted\":" << counters.deleted
+        << ",\"allocations\":" << counters.allocated.count
+        << ",\"allocatedBytes\":" << counters.allocated.bytes
+        << ",\"occupiedCells\":" << counters.occupancy.cells
+        << ",\"meanOccupancy\":" << counters.occupancy.mean
+        << ",\"maxOccupancy\":" << counters.occupancy.max
+        << ",\"cellSize\":" << *counters.occupancy.cellSize << "}\n";
+}
+
+} // namespace phys
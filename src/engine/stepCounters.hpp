@@ -0,0 +1,61 @@
+#ifndef ENGINE_STEPCOUNTERS_HPP
+#define ENGINE_STEPCOUNTERS_HPP
+
+#include "memory.hpp"
+#include "units.hpp"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+namespace phys {
+
+/// Atoms per cell of the grid built by the last collision step.
+struct CellOccupancy {
+    size_t cells = 0; // occupied cells
+    num_t mean = 0;   // atoms per occupied cell
+    size_t max = 0;
+    Length cellSize{}; // picked by the tuner, periodic axes stretch it to whole cells
+};
+
+/// Broad phase pairs compared with a brute-force search in random windows of the chamber.
+struct BroadPhaseAudit {
+    size_t windows = 0;  // windows searched
+    size_t overlaps = 0; // overlapping pairs found by brute force
+    size_t missed = 0;   // of them, not reported by the broad phase
+
+    /// Share of the overlaps the broad phase missed.
+    num_t missRate() const {
+        return overlaps == 0 ? num_t{0} : num_t{missed} / num_t{overlaps};
+    }
+};
+
+enum class StepPhase : uint8_t {
+    Move = 0,       // free flight and the velocity histogram sample
+    Walls = 1,      // wall reflections, periodic wrapping, removal of escaped atoms
+    BroadPhase = 2, // hashing, sorting and pair tests of the cell grid
+    Resolve = 3,    // collision response of the overlapping pairs
+};
+
+constexpr const size_t StepPhases = 4;
+
+const char* phaseName(StepPhase phase);
+
+/// What the last step did and how long it took, cheap enough to be kept for every step.
+struct StepCounters {
+    size_t step = 0; // steps done, the counters are of the last one
+    std::array<double, StepPhases> phaseSeconds{};
+    size_t pairsTested = 0;        // distance checks of the broad phase
+    size_t collisionsFound = 0;    // overlapping pairs
+    size_t collisionsResolved = 0; // overlapping pairs that were approaching
+    size_t deleted = 0;            // atoms escaped through the hole
+    AllocationStats allocated;     // heap traffic of the step, see AllocationStats
+    CellOccupancy occupancy;       // of the grid of the step, empty without collisions
+};
+
+/// Writes the counters as one line of JSON.
+void writeJson(std::ostream& out, const StepCounters& counters);
+
+} // namespace phys
+
+#endif /* ENGINE_STEPCOUNTERS_HPP */
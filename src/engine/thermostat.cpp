@@ -0,0 +1,26 @@
+#include "thermostat.hpp"
+
+#include <algorithm>
+
+namespace phys {
+
+const char* thermostatName(ThermostatMode mode) {
+    switch (mode) {
+    case ThermostatMode::Off:
+        return "off";
+    case ThermostatMode::Rescale:
+        return "rescale";
+    case ThermostatMode::Andersen:
+        return "andersen";
+    }
+    return "unknown";
+}
+
+Temperature Thermostat::target(Temperature start, size_t step) const {
+    if (step >= rampSteps) {
+        return temperature;
+    }
+    return start + (temperature - start) * num_t{static_cast<double>(step) / static_cast<double>(rampSteps)};
+}
+
+} // namespace phys
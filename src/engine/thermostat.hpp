@@ -0,0 +1,49 @@
+#ifndef ENGINE_THERMOSTAT_HPP
+#define ENGINE_THERMOSTAT_HPP
+
+#include "units.hpp"
+#include <cstdint>
+
+namespace phys {
+
+enum class ThermostatMode : uint8_t {
+    Off = 0,
+    Rescale = 1,  // every velocity is scaled towards the target temperature
+    Andersen = 2, // random atoms collide with a bath and get Maxwell velocities of the target
+};
+
+const char* thermostatName(ThermostatMode mode);
+
+/// Heat bath of the atoms, applied in the move pass of every step.
+struct Thermostat {
+    ThermostatMode mode = ThermostatMode::Off;
+    Temperature temperature{}; // target at the end of the ramp
+
+    /// Steps the target moves over linearly from the temperature the thermostat starts at,
+    /// 0 sets it at once.
+    size_t rampSteps = 0;
+
+    /// Rescale: steps the gap to the target closes over (Berendsen), 1 rescales exactly.
+    size_t relaxSteps = 1;
+
+    /// Andersen: chance of an atom to collide with the bath in a step.
+    num_t collisionRate = 0.01;
+
+    /// Andersen: equal seeds give equal collisions of equal chambers.
+    uint64_t seed = 1;
+
+    /// Target of the given step of the ramp.
+    Temperature target(Temperature start, size_t step) const;
+};
+
+struct ThermostatStats {
+    ThermostatMode mode = ThermostatMode::Off;
+    Temperature target{};      // of the last step
+    Temperature temperature{}; // of the atoms after the last step's thermostat
+    Energy heat{};             // added to the atoms since the start, negative if taken away
+    size_t collisions = 0;     // with the bath since the start
+};
+
+} // namespace phys
+
+#endif /* ENGINE_THERMOSTAT_HPP */
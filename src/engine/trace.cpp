@@ -0,0 +1,94 @@
+#include "trace.hpp"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace phys {
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    int64_t arg;
+    TraceClock::time_point begin;
+    TraceClock::time_point end;
+};
+
+// Written by its thread only, head is published after the event.
+struct TraceRing {
+    std::array<TraceEvent, TraceCapacity> events;
+    std::atomic<size_t> head = 0;
+    size_t tid = 0;
+};
+
+std::atomic<bool> tracing = false;
+const TraceClock::time_point epoch = TraceClock::now();
+
+QMutex ringsMutex;
+std::vector<std::unique_ptr<TraceRing>> rings;
+
+TraceRing& threadRing() {
+    thread_local TraceRing* ring = [] {
+        QMutexLocker<QMutex> locker(&ringsMutex);
+        rings.push_back(std::make_unique<TraceRing>());
+        rings.back()->tid = rings.size();
+        return rings.back().get();
+    }();
+    return *ring;
+}
+
+double micros(TraceClock::time_point t) {
+    return std::chrono::duration<double, std::micro>(t - epoch).count();
+}
+
+} // namespace
+
+void setTracing(bool enable) {
+    tracing.store(enable, std::memory_order_relaxed);
+}
+
+bool isTracing() {
+    return tracing.load(std::memory_order_relaxed);
+}
+
+void traceSpan(const char* name, int64_t arg, TraceClock::time_point begin, TraceClock::time_point end) {
+    if (!isTracing())
+        return;
+    TraceRing& ring = threadRing();
+    const size_t head = ring.head.load(std::memory_order_relaxed);
+    ring.events[head % TraceCapacity] = {name, arg, begin, end};
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void writeTrace(std::ostream& out) {
+    QMutexLocker<QMutex> locker(&ringsMutex);
+    const auto flags = out.flags();
+    const auto precision = out.precision(3);
+    out << std::fixed << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto& ring : rings) {
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->tid
+            << ",\"args\":{\"name\":\"thread " << ring->tid << "\"}}";
+        first = false;
+
+        const size_t head = ring->head.load(std::memory_order_acquire);
+        for (size_t i = head > TraceCapacity ? head - TraceCapacity : 0; i < head; ++i) {
+            const TraceEvent& event = ring->events[i % TraceCapacity];
+            out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->tid
+                << ",\"ts\":" << micros(event.begin) << ",\"dur\":" << micros(event.end) - micros(event.begin);
+            if (event.arg >= 0) {
+                out << ",\"args\":{\"chunk\":" << event.arg << '}';
+            }
+            out << '}';
+        }
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+} // namespace phys
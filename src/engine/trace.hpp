@@ -0,0 +1,58 @@
+#ifndef ENGINE_TRACE_HPP
+#define ENGINE_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace phys {
+
+using TraceClock = std::chrono::steady_clock;
+
+/// Events kept per thread, older ones are overwritten.
+const size_t TraceCapacity = 1 << 15;
+
+/// Off by default, while off spans cost one relaxed load.
+void setTracing(bool enable);
+
+bool isTracing();
+
+/**
+ * @brief Records a span of the calling thread into its ring.
+ *
+ * @param name - static string, shown as the event name
+ * @param arg - chunk index or -1, shown as an argument of the event
+ */
+void traceSpan(const char* name, int64_t arg, TraceClock::time_point begin, TraceClock::time_point end);
+
+/// Span from construction to destruction.
+class TraceScope {
+    const char* m_name;
+    int64_t m_arg;
+    bool m_active;
+    TraceClock::time_point m_begin;
+
+public:
+    explicit TraceScope(const char* name, int64_t arg = -1)
+        : m_name(name), m_arg(arg), m_active(isTracing()) {
+        if (m_active) {
+            m_begin = TraceClock::now();
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    ~TraceScope() {
+        if (m_active) {
+            traceSpan(m_name, m_arg, m_begin, TraceClock::now());
+        }
+    }
+};
+
+/// Writes the rings of all threads as Chrome trace-event JSON (chrome://tracing, Perfetto).
+void writeTrace(std::ostream& out);
+
+} // namespace phys
+
+#endif /* ENGINE_TRACE_HPP */
@@ -7,10 +7,10 @@
 #include <cstdint>
 
 #define PHYS_UNITS_PROVIDE_LITERALS // FIXME: Compile option
-#define PHYS_UNIVERSE_DIM 3
 namespace phys {
 
-const std::size_t UniverseDim = PHYS_UNIVERSE_DIM;
+/// Largest dimension the engine is instantiated for, dimension-free metrics are sized for it.
+const std::size_t MaxDim = 3;
 
 namespace detail {
 class UnitBase {}; // Needed for fast abstraction
@@ -175,7 +175,8 @@ using LengthVal = Unit<num_t, 1>; // m
 
 using SquareVal = Unit<num_t, 2>; // m^2
 
-using VolumeVal = Unit<num_t, UniverseDim>; // m^3
+template <std::size_t Dim>
+using VolumeVal = Unit<num_t, static_cast<int>(Dim)>; // m^Dim
 
 using VelocityVal = Unit<num_t, 1, -1>; // m * s^-1
 
@@ -183,7 +184,8 @@ using AccelerationVal = Unit<num_t, 1, -2>; // m * s^-2
 
 using ForceVal = Unit<num_t, 1, -2, 1>; // kg * m * s^-2
 
-using PressureVal = decltype(ForceVal{} * LengthVal{} / VolumeVal{}); // kg * m^-1 * s^-2
+template <std::size_t Dim>
+using PressureVal = decltype(ForceVal{} * LengthVal{} / VolumeVal<Dim>{}); // kg * m^(2-Dim) * s^-2
 
 using TimeVal = Unit<num_t, 0, 1, 0>; // s
 
@@ -201,22 +203,32 @@ using TemperatureVal = Unit<num_t, 0, 0, 0, 1>; // kg * m^2 * s^-1
 
 using Length = LengthVal;
 using Square = SquareVal;
-using Volume = VolumeVal;
-using Pressure = PressureVal;
+template <std::size_t Dim>
+using Volume = VolumeVal<Dim>;
+template <std::size_t Dim>
+using Pressure = PressureVal<Dim>;
 using Temperature = TemperatureVal;
 
-template <SomeUnit T>
-using Vector = geom::Vector<T, UniverseDim, UnitTraits>;
-
-using Position = Vector<LengthVal>;
-using Distance = Vector<LengthVal>;
-using MassMoment = Vector<MassMomentVal>;
-
-using Velocity = Vector<VelocityVal>;
-using Acceleration = Vector<AccelerationVal>;
-using Force = Vector<ForceVal>;
-using Impulse = Vector<ImpulseVal>;
-using ImpulseMoment = Vector<ImpulseMomentVal>;
+template <SomeUnit T, std::size_t Dim>
+using Vector = geom::Vector<T, Dim, UnitTraits>;
+
+template <std::size_t Dim>
+using Position = Vector<LengthVal, Dim>;
+template <std::size_t Dim>
+using Distance = Vector<LengthVal, Dim>;
+template <std::size_t Dim>
+using MassMoment = Vector<MassMomentVal, Dim>;
+
+template <std::size_t Dim>
+using Velocity = Vector<VelocityVal, Dim>;
+template <std::size_t Dim>
+using Acceleration = Vector<AccelerationVal, Dim>;
+template <std::size_t Dim>
+using Force = Vector<ForceVal, Dim>;
+template <std::size_t Dim>
+using Impulse = Vector<ImpulseVal, Dim>;
+template <std::size_t Dim>
+using ImpulseMoment = Vector<ImpulseMomentVal, Dim>;
 
 using Time = TimeVal;
 using Mass = MassVal;
@@ -260,62 +272,62 @@ std::pair<num_t, const char*> getSuff(const T& unit) {
     return suffixes[sizeof(suffixes) / sizeof(suffixes[0]) - 1];
 }
 
-template <SomeUnit T, SomeUnit U>
-auto operator*(const Vector<T>& lhs, const U& rhs) -> Vector<decltype(lhs[0] * rhs)> {
-    Vector<decltype(lhs[0] * rhs)> ans{};
-    for (size_t i = 0; i < UniverseDim; ++i) {
+template <SomeUnit T, SomeUnit U, std::size_t Dim>
+auto operator*(const Vector<T, Dim>& lhs, const U& rhs) -> Vector<decltype(lhs[0] * rhs), Dim> {
+    Vector<decltype(lhs[0] * rhs), Dim> ans{};
+    for (size_t i = 0; i < Dim; ++i) {
         ans[i] = lhs[i] * rhs;
     }
     return ans;
 }
 
-template <SomeUnit T, SomeUnit U>
-auto MulByElement(const Vector<T>& lhs, const Vector<U>& rhs) -> Vector<decltype(lhs[0] * rhs[0])> {
-    Vector<decltype(lhs[0] * rhs[0])> ans{};
-    for (size_t i = 0; i < UniverseDim; ++i) {
+template <SomeUnit T, SomeUnit U, std::size_t Dim>
+auto MulByElement(const Vector<T, Dim>& lhs, const Vector<U, Dim>& rhs) -> Vector<decltype(lhs[0] * rhs[0]), Dim> {
+    Vector<decltype(lhs[0] * rhs[0]), Dim> ans{};
+    for (size_t i = 0; i < Dim; ++i) {
         ans[i] = lhs[i] * rhs[i];
     }
     return ans;
 }
 
-template <SomeUnit T, typename U>
-auto operator/(const Vector<T>& lhs, const U& rhs) -> Vector<decltype(lhs[0] / rhs)> {
-    Vector<decltype(lhs[0] / rhs)> ans{};
-    for (size_t i = 0; i < UniverseDim; ++i) {
+template <SomeUnit T, typename U, std::size_t Dim>
+auto operator/(const Vector<T, Dim>& lhs, const U& rhs) -> Vector<decltype(lhs[0] / rhs), Dim> {
+    Vector<decltype(lhs[0] / rhs), Dim> ans{};
+    for (size_t i = 0; i < Dim; ++i) {
         ans[i] = lhs[i] / rhs;
     }
     return ans;
 }
 
-template <SomeUnit T>
-auto Normalize(const Vector<T>& t) {
+template <SomeUnit T, std::size_t Dim>
+auto Normalize(const Vector<T, Dim>& t) {
     assert(*t.Len() > 0.);
     return t / t.Len();
 }
 
-template <SomeUnit T>
-T Trace(const Vector<T>& t) {
+template <SomeUnit T, std::size_t Dim>
+T Trace(const Vector<T, Dim>& t) {
     T ans{};
-    for (size_t i = 0; i < UniverseDim; ++i) {
+    for (size_t i = 0; i < Dim; ++i) {
         ans += t[i];
     }
     return ans;
 }
 
-template <SomeUnit T>
-Vector<T> randomSphere() {
-    Vector<T> v;
-    for (size_t i = 0; i < UniverseDim; ++i) {
+template <SomeUnit T, std::size_t Dim>
+Vector<T, Dim> randomSphere() {
+    Vector<T, Dim> v;
+    for (size_t i = 0; i < Dim; ++i) {
         v[i] = T{num_t{rand()}};
     }
     v /= *v.Len();
     return v;
 }
 
-template <SomeUnit T>
-Vector<T> randomInCube(Vector<T> mx) {
-    Vector<T> v;
-    for (size_t i = 0; i < UniverseDim; ++i) {
+template <SomeUnit T, std::size_t Dim>
+Vector<T, Dim> randomInCube(Vector<T, Dim> mx) {
+    Vector<T, Dim> v;
+    for (size_t i = 0; i < Dim; ++i) {
         v[i] = mx[i] * num_t{rand()};
     }
     v /= num_t{RAND_MAX};
@@ -326,8 +338,8 @@ static inline num_t randomShift() {
     return num_t{(rand() - RAND_MAX / 2)} / num_t{RAND_MAX};
 }
 
-template <SomeUnit T, SomeUnit U>
-Unit<num_t> GetSinusBetween(const Vector<T>& lhs, const Vector<U>& rhs) {
+template <SomeUnit T, SomeUnit U, std::size_t Dim>
+Unit<num_t> GetSinusBetween(const Vector<T, Dim>& lhs, const Vector<U, Dim>& rhs) {
     auto lens_product = lhs.Len() * rhs.Len();
     auto cos_alpha = (lhs, rhs) / lens_product;
     auto sin_alpha = Unit<num_t>{1} - cos_alpha * cos_alpha;
@@ -381,7 +393,7 @@ struct UnitFormatter<EnergyVal> {
 };
 
 template <>
-struct UnitFormatter<PressureVal> {
+struct UnitFormatter<PressureVal<3>> {
     static constexpr std::string str() {
         return "Pa";
     }
@@ -0,0 +1,47 @@
+#include "vacf.hpp"
+
+namespace phys {
+
+num_t VacfStats::Series::vacf(size_t level, size_t lag) const {
+    return count[level][lag] == 0 ? num_t{0} : sum[level][lag] / num_t{count[level][lag]};
+}
+
+num_t VacfStats::Series::vacfZero() const {
+    return zeroCount == 0 ? num_t{0} : zero / num_t{zeroCount};
+}
+
+Time VacfStats::lagTime(size_t level, size_t lag) const {
+    return LagWindows::lagTime(sampleTime, level, lag);
+}
+
+// Integral of the correlation up to its first sign change, m^2/s.
+static num_t integrate(const VacfStats& stats, const VacfStats::Series& series) {
+    num_t integral = 0;
+    num_t lastTime = 0;
+    num_t lastValue = series.vacfZero();
+    for (size_t level = 0; level < VacfStats::Levels; ++level) {
+        for (size_t lag = 0; lag < VacfStats::Lags; ++lag) {
+            const num_t t = *stats.lagTime(level, lag);
+            if (series.count[level][lag] == 0 || !(t > lastTime))
+                continue;
+            const num_t value = series.vacf(level, lag);
+            if (value * lastValue < num_t{0})
+                return integral;
+            integral += (value + lastValue) * (t - lastTime) / num_t{2};
+            lastTime = t;
+            lastValue = value;
+        }
+    }
+    return integral;
+}
+
+void integrateGreenKubo(VacfStats& stats) {
+    for (auto& series : stats.species) {
+        series.diffusion = 0;
+        if (series.zeroCount != 0 && *stats.sampleTime > num_t{0}) {
+            series.diffusion = integrate(stats, series) / num_t{stats.dim};
+        }
+    }
+}
+
+} // namespace phys
@@ -0,0 +1,57 @@
+#ifndef ENGINE_VACF_HPP
+#define ENGINE_VACF_HPP
+
+#include "lagWindows.hpp"
+#include <array>
+#include <vector>
+
+namespace phys {
+
+/**
+ * @brief Velocity autocorrelation <v(0) v(t)> of every species over the lags of LagWindows.
+ *
+ * Levels correlate point samples of the velocity with the last Lags samples of the level, so
+ * the memory stays Lags velocities per atom and level and no trajectory is kept.
+ * Velocities are unfolded like the MSD positions, a wall reflection does not decorrelate them.
+ */
+struct VacfStats {
+    static const size_t Levels = LagWindows::Levels;
+    static const size_t Lags = LagWindows::Lags;
+
+    struct Series {
+        /// v^2 summed over atoms and samples, m^2/s^2.
+        num_t zero = 0;
+        size_t zeroCount = 0;
+
+        /// v(0) v(t) summed over atoms and origins, m^2/s^2.
+        std::array<std::array<num_t, Lags>, Levels> sum{};
+        std::array<std::array<size_t, Lags>, Levels> count{};
+
+        /// Green-Kubo self-diffusion coefficient, m^2/s.
+        num_t diffusion = 0;
+
+        /// Mean of a lag, m^2/s^2, 0 without samples.
+        num_t vacf(size_t level, size_t lag) const;
+
+        num_t vacfZero() const;
+    };
+
+    size_t dim = MaxDim;
+    Time sampleTime{}; // period of level 0
+
+    std::vector<Series> species; // by species id
+
+    Time lagTime(size_t level, size_t lag) const;
+};
+
+/**
+ * @brief Integrates D = 1 / dim * int <v(0) v(t)> dt for every species.
+ *
+ * Trapezoids run over the lags in time order, a level only adds the lags past the previous one.
+ * The integral stops at the first sign change of the correlation, where the noise takes over.
+ */
+void integrateGreenKubo(VacfStats& stats);
+
+} // namespace phys
+
+#endif /* ENGINE_VACF_HPP */
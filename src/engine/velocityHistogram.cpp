@@ -0,0 +1,51 @@
+#include "velocityHistogram.hpp"
+#include <numbers>
+
+namespace phys {
+
+// Share of atoms with speed below s * sigma.
+static double speedCdf(size_t dim, double s) {
+    if (dim == 2) {
+        return 1 - std::exp(-s * s / 2);
+    } else {
+        return std::erf(s / std::numbers::sqrt2) -
+               std::sqrt(2 / std::numbers::pi) * s * std::exp(-s * s / 2);
+    }
+}
+
+// Share of atoms with one velocity component below s * sigma.
+static double axisCdf(double s) {
+    return (1 + std::erf(s / std::numbers::sqrt2)) / 2;
+}
+
+void fitMaxwell(VelocityHistogram& hist, VelocityVal sigma) {
+    const size_t bins = VelocityHistogram::Bins;
+    if (hist.count == 0 || !(*sigma > num_t{0}) || !(*hist.range > num_t{0})) {
+        hist.maxwellSpeed.fill(0);
+        hist.maxwellAxis.fill(0);
+        hist.deviation = 1;
+        return;
+    }
+
+    const double count = static_cast<double>(hist.count);
+    const double speedStep = static_cast<double>(*(hist.range / sigma)) / bins;
+    const double axisStep = 2 * speedStep;
+
+    double distance = 0;
+    double observedTail = 1;
+    for (size_t i = 0; i < bins; ++i) {
+        double expected = speedCdf(hist.dim, speedStep * (i + 1)) - speedCdf(hist.dim, speedStep * i);
+        double observed = static_cast<double>(hist.speed[i]) / count;
+        hist.maxwellSpeed[i] = expected * count;
+        distance += std::abs(observed - expected);
+        observedTail -= observed;
+
+        double lo = axisStep * static_cast<double>(i) - axisStep * bins / 2;
+        hist.maxwellAxis[i] = (axisCdf(lo + axisStep) - axisCdf(lo)) * count;
+    }
+    // Atoms beyond the last bin are compared as one more bin.
+    distance += std::abs(observedTail - (1 - speedCdf(hist.dim, speedStep * bins)));
+    hist.deviation = distance / 2;
+}
+
+} // namespace phys
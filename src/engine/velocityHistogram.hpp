@@ -0,0 +1,48 @@
+#ifndef ENGINE_VELOCITYHISTOGRAM_HPP
+#define ENGINE_VELOCITYHISTOGRAM_HPP
+
+#include "units.hpp"
+#include <array>
+
+namespace phys {
+
+/**
+ * @brief Speed and per-axis velocity distribution of one sampled step.
+ *
+ * Velocities are taken as v * sqrt(m / <m>), so a mixture in equilibrium follows a single
+ * Maxwell distribution of the mean mass. For one species this is the plain velocity.
+ */
+struct VelocityHistogram {
+    static const size_t Bins = 64;
+
+    size_t dim = MaxDim;
+    size_t count = 0; // atoms in the sample
+    size_t step = 0;  // step the sample was taken at
+
+    /// Speed bins cover [0, range), axis bins cover [-range, range).
+    VelocityVal range{};
+
+    std::array<size_t, Bins> speed{};
+    std::array<std::array<size_t, Bins>, MaxDim> axis{}; // first dim are used
+
+    /// Maxwell expectation for the same bins, in atoms.
+    std::array<num_t, Bins> maxwellSpeed{};
+    std::array<num_t, Bins> maxwellAxis{};
+
+    Temperature temperature{};
+
+    /// Total variation distance between the speed histogram and Maxwell, 0..1.
+    num_t deviation = 1;
+};
+
+/**
+ * @brief Fills the Maxwell expectation and the deviation of the histogram.
+ *
+ * @param hist - histogram with counts and range set
+ * @param sigma - velocity dispersion along one axis, same units as range
+ */
+void fitMaxwell(VelocityHistogram& hist, VelocityVal sigma);
+
+} // namespace phys
+
+#endif /* ENGINE_VELOCITYHISTOGRAM_HPP */
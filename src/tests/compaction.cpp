@@ -0,0 +1,95 @@
+#include "ballsCollection.hpp"
+#include "physconstants.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace phys;
+
+// Atoms of a species fly at one speed without colliding, so whatever atoms escape, every
+// MSD lag is v^2 t^2 and every VACF lag v^2. A column compacted out of step with the others
+// breaks the speeds of the species or these correlations.
+int main() {
+    const std::array<Mass, 2> masses = {consts::Dalton * num_t{4}, consts::Dalton * num_t{40}};
+    const std::array<num_t, 2> speeds = {300, 100};
+    const size_t atoms = 2000;
+    const Time dt = 1e-13_sec;
+
+    BallsCollection<3> balls(1e-9_m, 1e-12_sec);
+    balls.setWalls(Position<3>{20e-9_m, 20e-9_m, 20e-9_m});
+    balls.setCellSize(1e-9_m);
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> place(1, 19);
+    std::normal_distribution<double> direction;
+    size_t added = 0;
+    balls.addAtoms(atoms, [&] () {
+        const size_t species = added++ % 2;
+        std::array<double, 3> v = {direction(random), direction(random), direction(random)};
+        const double norm = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        Velocity<3> velocity;
+        for (size_t d = 0; d < 3; ++d) {
+            velocity[d] = VelocityVal{speeds[species] * num_t{v[d] / norm}};
+        }
+        Position<3> pos{Length{place(random) * 1e-9}, Length{place(random) * 1e-9}, Length{place(random) * 1e-9}};
+        return GasAtom<3>{pos, velocity, masses[species], 0.1e-9_m};
+    });
+
+    balls.setMsdPeriod(1);
+    balls.setVacfPeriod(1);
+    balls.setEnableHole(true);
+    for (size_t step = 0; step < 4000; ++step) {
+        balls.move(dt);
+        balls.handleWallCollisions();
+    }
+
+    size_t failures = 0;
+    auto check = [&failures] (bool ok, const char* what, num_t got, num_t expected) {
+        if (!ok && failures++ < 10) {
+            std::cerr << what << ": got " << got << ", expected " << expected << "\n";
+        }
+    };
+    auto close = [] (num_t got, num_t expected) {
+        return std::abs(got - expected) <= num_t{1e-6} * std::abs(expected);
+    };
+
+    check(balls.size() < atoms, "atoms after the hole", num_t{balls.size()}, num_t{atoms});
+    for (size_t i = 0; i < balls.size(); ++i) {
+        const GasAtom<3> atom = balls.getAtom(i);
+        const size_t species = atom.getMass() == masses[0] ? 0 : 1;
+        check(atom.getMass() == masses[species], "mass", *atom.getMass(), *masses[species]);
+        check(close(*atom.getVelocity().Len(), speeds[species]), "speed", *atom.getVelocity().Len(), speeds[species]);
+        for (size_t d = 0; d < 3; ++d) {
+            const Length pos = atom.getPos()[d];
+            check(pos >= Length{0} && pos <= balls.getWall(d), "coordinate", *pos, *balls.getWall(d));
+        }
+    }
+
+    MsdStats msd;
+    balls.getMsd(msd);
+    VacfStats vacf;
+    balls.getVacf(vacf);
+    for (SpeciesId id = 0; id < balls.getSpeciesCount(); ++id) {
+        const size_t species = balls.getSpecies(id).mass == masses[0] ? 0 : 1;
+        const num_t v2 = speeds[species] * speeds[species];
+        for (size_t level = 0; level < MsdStats::Levels; ++level) {
+            for (size_t lag = 0; lag < MsdStats::Lags; ++lag) {
+                if (msd.species[id].count[level][lag] != 0) {
+                    const num_t t = *msd.lagTime(level, lag);
+                    check(close(msd.species[id].msd(level, lag, msd.free), v2 * t * t), "MSD",
+                          msd.species[id].msd(level, lag, msd.free), v2 * t * t);
+                }
+                if (vacf.species[id].count[level][lag] != 0) {
+                    check(close(vacf.species[id].vacf(level, lag), v2), "VACF", vacf.species[id].vacf(level, lag), v2);
+                }
+            }
+        }
+    }
+
+    if (failures != 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include "renderBuffer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using namespace phys;
+
+// sortByDepth() has to give the order of std::stable_sort by Z. X and Y carry the input index,
+// so atoms of equal depth that swap places fail the check too.
+int main() {
+    std::mt19937 random(1);
+    size_t failures = 0;
+    for (size_t n : {0, 1, 15, 17, 1000, 100003}) {
+        for (uint32_t depths : {4u, 300u, RenderQuantMax + 1}) {
+            std::uniform_int_distribution<uint32_t> depth(0, depths - 1);
+            Column<RenderAtom> atoms(n);
+            for (size_t i = 0; i < n; ++i) {
+                atoms[i].pos = {static_cast<uint16_t>(i), static_cast<uint16_t>(i >> 16), static_cast<uint16_t>(depth(random))};
+                atoms[i].color = static_cast<uint8_t>(i);
+                atoms[i].radius = static_cast<uint8_t>(i >> 8);
+            }
+
+            Column<RenderAtom> expected = atoms;
+            std::stable_sort(expected.begin(), expected.end(), [] (const RenderAtom& a, const RenderAtom& b) {
+                return a.pos[2] < b.pos[2];
+            });
+
+            Column<RenderAtom> buffer;
+            sortByDepth(atoms, buffer);
+            const bool equal = std::equal(atoms.begin(), atoms.end(), expected.begin(), expected.end(),
+                                          [] (const RenderAtom& a, const RenderAtom& b) {
+                return a.pos == b.pos && a.color == b.color && a.radius == b.radius;
+            });
+            if (!equal) {
+                std::cerr << "sortByDepth of " << n << " atoms over " << depths << " depths differs from std::stable_sort\n";
+                failures++;
+            }
+        }
+    }
+
+    if (failures != 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "ballsCollection.hpp"
+#include "physconstants.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace phys;
+
+static const Mass HeliumMass = consts::Dalton * num_t{4};
+static const Time Dt = 1e-13_sec;
+
+// Chamber of non-colliding helium atoms, periodic along every axis.
+static void addAtoms(BallsCollection<3>& balls, size_t atoms, num_t speed) {
+    balls.setWalls(Position<3>{20e-9_m, 20e-9_m, 20e-9_m});
+    for (size_t d = 0; d < 3; ++d) {
+        balls.setBoundary(d, Boundary::Periodic);
+    }
+    balls.setCellSize(1e-9_m);
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> place(0, 20);
+    std::normal_distribution<double> direction;
+    balls.addAtoms(atoms, [&] () {
+        std::array<double, 3> v = {direction(random), direction(random), direction(random)};
+        const double norm = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        Velocity<3> velocity;
+        for (size_t d = 0; d < 3; ++d) {
+            velocity[d] = VelocityVal{speed * num_t{v[d] / norm}};
+        }
+        Position<3> pos{Length{place(random) * 1e-9}, Length{place(random) * 1e-9}, Length{place(random) * 1e-9}};
+        return GasAtom<3>{pos, velocity, HeliumMass, 0.1e-9_m};
+    });
+}
+
+static void run(BallsCollection<3>& balls, size_t steps) {
+    for (size_t step = 0; step < steps; ++step) {
+        balls.move(Dt);
+        balls.handleWallCollisions();
+    }
+}
+
+// Flights at one speed v through the periodic sides: every lag of every level is v^2 t^2.
+static size_t checkBallistic() {
+    const num_t speed = 300;
+    BallsCollection<3> balls(1e-9_m, 1e-12_sec);
+    addAtoms(balls, 1000, speed);
+    balls.setMsdPeriod(1);
+    run(balls, 1000);
+
+    MsdStats stats;
+    balls.getMsd(stats);
+    size_t failures = 0;
+    size_t lags = 0;
+    for (size_t level = 0; level < MsdStats::Levels; ++level) {
+        for (size_t lag = 0; lag < MsdStats::Lags; ++lag) {
+            if (stats.species[0].count[level][lag] == 0)
+                continue;
+            lags++;
+            const num_t t = *stats.lagTime(level, lag);
+            const num_t expected = speed * speed * t * t;
+            const num_t msd = stats.species[0].msd(level, lag, stats.free);
+            if (std::abs(msd - expected) > num_t{1e-6} * expected && failures++ < 10) {
+                std::cerr << "ballistic MSD of level " << level << " lag " << lag << ": got " << msd
+                          << ", expected " << expected << "\n";
+            }
+        }
+    }
+    if (lags < 2 * MsdStats::Lags) {
+        std::cerr << "ballistic MSD: only " << lags << " lags sampled\n";
+        failures++;
+    }
+    return failures;
+}
+
+// Andersen bath with collision chance p per step: velocities along an axis stay correlated as
+// kT/m (1 - p)^k over k steps, so the walk diffuses with D = kT/m dt (1/p - 1/2).
+static size_t checkDiffusion() {
+    const Temperature temperature = 300_K;
+    const num_t rate = 0.2;
+    BallsCollection<3> balls(1e-9_m, 1e-12_sec);
+    addAtoms(balls, 2000, 1000);
+
+    Thermostat thermostat;
+    thermostat.mode = ThermostatMode::Andersen;
+    thermostat.temperature = temperature;
+    thermostat.collisionRate = rate;
+    balls.setThermostat(thermostat);
+    run(balls, 100);
+
+    balls.setMsdPeriod(1);
+    balls.setVacfPeriod(1);
+    run(balls, 8193);
+
+    const num_t expected = *(consts::k * temperature / HeliumMass * Dt) * (num_t{1} / rate - num_t{0.5});
+    MsdStats msd;
+    balls.getMsd(msd);
+    VacfStats vacf;
+    balls.getVacf(vacf);
+
+    size_t failures = 0;
+    const std::array<std::pair<const char*, num_t>, 2> estimates = {{
+        {"MSD", msd.species[0].diffusion},
+        {"Green-Kubo", vacf.species[0].diffusion},
+    }};
+    for (const auto& [name, diffusion] : estimates) {
+        if (!(std::abs(diffusion - expected) <= num_t{0.05} * expected)) {
+            std::cerr << name << " diffusion: got " << diffusion << ", expected " << expected << "\n";
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main() {
+    const size_t failures = checkBallistic() + checkDiffusion();
+    if (failures != 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "ballsCollection.hpp"
+#include "physconstants.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace phys;
+
+static size_t failures = 0;
+
+static void checkClose(const char* what, num_t got, num_t expected) {
+    if (!(std::abs(got - expected) <= num_t{1e-6} * std::abs(expected)) && failures++ < 10) {
+        std::cerr << what << ": got " << got << ", expected " << expected << "\n";
+    }
+}
+
+// Temperature of the atoms from their kinetic energy, independent of the thermostat stats.
+static num_t measure(const BallsCollection<3>& balls) {
+    return *(Trace(balls.getKineticDistributed()) * num_t{2. / 3} / num_t{balls.size()} / consts::k);
+}
+
+static void run(BallsCollection<3>& balls, size_t steps) {
+    for (size_t step = 0; step < steps; ++step) {
+        balls.move(1e-13_sec);
+        balls.handleWallCollisions();
+    }
+}
+
+// Non-colliding atoms keep their energy, so only the thermostat changes the temperature.
+int main() {
+    BallsCollection<3> balls(1e-9_m, 1e-12_sec);
+    balls.setWalls(Position<3>{20e-9_m, 20e-9_m, 20e-9_m});
+    balls.setCellSize(1e-9_m);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> place(1, 19), speed(-300, 300);
+    balls.addAtoms(2000, [&] () {
+        Position<3> pos{Length{place(random) * 1e-9}, Length{place(random) * 1e-9}, Length{place(random) * 1e-9}};
+        Velocity<3> velocity{VelocityVal{speed(random)}, VelocityVal{speed(random)}, VelocityVal{speed(random)}};
+        return GasAtom<3>{pos, velocity, consts::Dalton * num_t{4}, 0.1e-9_m};
+    });
+
+    // Berendsen closes the gap by a factor 1 - 1 / relaxSteps every step.
+    const num_t start = measure(balls);
+    Thermostat thermostat;
+    thermostat.mode = ThermostatMode::Rescale;
+    thermostat.temperature = 500_K;
+    thermostat.relaxSteps = 20;
+    balls.setThermostat(thermostat);
+    run(balls, 400);
+    checkClose("relaxed temperature", measure(balls), 500);
+    checkClose("relaxed temperature stats", *balls.getThermostatStats().temperature, 500);
+    checkClose("heat", *balls.getThermostatStats().heat, *(num_t{1.5} * num_t{balls.size()} * consts::k * (500_K - Temperature{start})));
+
+    // A ramp of exact rescales follows the target on every step and ends on it.
+    thermostat.temperature = 200_K;
+    thermostat.rampSteps = 100;
+    thermostat.relaxSteps = 1;
+    balls.setThermostat(thermostat);
+    for (size_t step = 0; step < thermostat.rampSteps; ++step) {
+        run(balls, 1);
+        const Temperature target = thermostat.target(500_K, step);
+        checkClose("ramp target", *balls.getThermostatStats().target, *target);
+        checkClose("ramp temperature", measure(balls), *target);
+    }
+    run(balls, 1);
+    checkClose("ramp end", measure(balls), 200);
+
+    if (failures != 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "chamberdisplayer.hpp"
+#include "parallel.hpp"
 #include "physconstants.hpp"
 #include <QBrush>
 #include <QDateTimeEdit>
@@ -8,7 +9,9 @@
 #include <QPushButton>
 #include <QSpinBox>
 #include <QTimer>
+#include <QtConcurrent/QtConcurrent>
 #include <iostream>
+#include <numeric>
 
 ChamberDisplayer::ChamberDisplayer(phys::Chamber::Metrics& metrics, QWidget* parent)
     : QWidget(parent)
@@ -20,6 +23,7 @@ ChamberDisplayer::ChamberDisplayer(phys::Chamber::Metrics& metrics, QWidget* par
     setAutoFillBackground(true);
     m_record.fill(std::make_pair(QPoint{}, QColor("transparent")));
     setPalette(pal);
+    setCamera(m_camera);
 }
 
 ChamberDisplayer::~ChamberDisplayer() {}
@@ -27,11 +31,26 @@ ChamberDisplayer::~ChamberDisplayer() {}
 void ChamberDisplayer::setColorPolicy(ColorPolicy newColorPolicy)
 {
     m_colorPolicy = newColorPolicy;
+    m_chamberMetrics.render.key = newColorPolicy == ColorPolicy::MassColor ? phys::RenderKey::Species
+                                                                          : phys::RenderKey::Heat;
+}
+
+void ChamberDisplayer::setViewMode(ViewMode newViewMode)
+{
+    m_viewMode = newViewMode;
+    m_chamberMetrics.render.field = static_cast<phys::FieldKind>(newViewMode);
+}
+
+void ChamberDisplayer::setCamera(Camera newCamera)
+{
+    m_camera = newCamera;
+    m_chamberMetrics.render.depthSorted = newCamera != Camera::Flat;
 }
 
 void ChamberDisplayer::setFollowIdx(int newFollowIdx)
 {
     m_followIdx = newFollowIdx;
+    m_chamberMetrics.render.followIdx = m_followIdx;
     m_recordIdx = 0;
     m_record.fill(std::make_pair(QPoint{}, QColor("transparent")));
 }
@@ -41,6 +60,21 @@ void ChamberDisplayer::setFollow(bool newFollow)
     m_follow = newFollow;
 }
 
+void ChamberDisplayer::setRaster(bool newRaster)
+{
+    m_raster = newRaster;
+}
+
+void ChamberDisplayer::setSampleSize(int newSampleSize)
+{
+    m_chamberMetrics.render.sampleSize = std::max(0, newSampleSize);
+}
+
+void ChamberDisplayer::setShowHistogram(bool newShowHistogram)
+{
+    m_showHistogram = newShowHistogram;
+}
+
 void ChamberDisplayer::resizeEvent(QResizeEvent* event) {
     QWidget::resizeEvent(event);
     rescale();
@@ -49,46 +83,38 @@ void ChamberDisplayer::resizeEvent(QResizeEvent* event) {
 void ChamberDisplayer::rescale() {}
 
 void ChamberDisplayer::paintEvent(QPaintEvent* /*event*/) {
-    auto& atoms = m_chamberMetrics.atoms;
-    // if constexpr (phys::UniverseDim >= 3) {
-    //     std::sort(atoms.begin(), atoms.end(),
-    //               [](const phys::GasAtom& lhs, const phys::GasAtom& rhs) -> bool {
-    //                   return lhs.getPos()[2] < rhs.getPos()[2];
-    //               });
-    // }
     QPainter painter(this);
     QPen pen;
     pen.setWidth(3);
-    painter.setPen(pen);
     phys::num_t pixscale{std::min(rect().width(), rect().height())};
 
+    if (m_viewMode != ViewMode::Atoms) {
+        drawField(painter, pixscale);
+    } else if (m_raster) {
+        rasterizeAtoms(pixscale);
+        painter.drawImage(0, 0, m_frame);
+    } else {
+        drawAtoms(painter, pixscale);
+    }
+
+    painter.setPen(pen);
     painter.drawRoundedRect(
         0, 0, static_cast<int>(pixscale * *(m_chamberMetrics.chamberCorner.X() / m_scale)),
         static_cast<int>(pixscale * *(m_chamberMetrics.chamberCorner.Y() / m_scale)), 3, 3);
 
-    painter.setPen(pen);
-    QBrush brush(Qt::SolidPattern);
-    painter.setBrush(brush);
-    size_t i = 0;
-    for (auto& atom : atoms) {
-        if(i++ > 5'000)
-            break;
-        QColor color = getColor(atom);
-        brush.setColor(color);
-        pen.setColor(color);
-        painter.setPen(pen);
-        painter.setBrush(brush);
+    if (m_followIdx < m_chamberMetrics.nAtoms) {
+        const auto& atom = m_chamberMetrics.followed;
+        QPoint pt{static_cast<int>(pixscale * *(atom.getPos().X() / m_scale)),
+                  static_cast<int>(pixscale * *(atom.getPos().Y() / m_scale))};
+        m_record[m_recordIdx++ % m_record.size()] = {pt, getColor(colorKey(atom, m_chamberMetrics.followedSpecies))};
+    }
 
-        int radius = static_cast<int>(pixscale * *(atom.getRadius() / m_scale));
-        radius = std::max(1, radius);
-        QPoint pt{static_cast<int>(pixscale * *((atom.getPos().X()) / m_scale)) - radius,
-                  static_cast<int>(pixscale * *((atom.getPos().Y()) / m_scale)) - radius};
-        painter.drawEllipse(pt.x(), pt.y(), 2 * radius, 2 * radius);
-        if(i == m_followIdx + 1) {
-            m_record[m_recordIdx++ % m_record.size()] = {pt, color};
-        }
+    if (m_showHistogram) {
+        drawHistogram(painter);
     }
-    if(m_follow) {       
+
+    if(m_follow) {
+        QBrush brush(Qt::SolidPattern);
         for(size_t j = 1; j < m_record.size() - 1; ++j) {
             QColor color = m_record[(m_recordIdx + j) % m_record.size()].second;
             QColor colorNext = m_record[(m_recordIdx + j + 1) % m_record.size()].second;
@@ -107,24 +133,261 @@ void ChamberDisplayer::paintEvent(QPaintEvent* /*event*/) {
     }
 }
 
-QColor ChamberDisplayer::getColor(const phys::GasAtom& atom) const {
+ChamberDisplayer::Projection ChamberDisplayer::makeProjection(phys::num_t pixscale) const {
+    const auto& corner = m_chamberMetrics.chamberCorner;
+    Projection proj;
+    proj.xScale = static_cast<double>(pixscale * *(corner.X() / m_scale)) / phys::RenderQuantMax;
+    proj.yScale = static_cast<double>(pixscale * *(corner.Y() / m_scale)) / phys::RenderQuantMax;
+    proj.centerX = proj.xScale * phys::RenderQuantMax / 2;
+    proj.centerY = proj.yScale * phys::RenderQuantMax / 2;
+    proj.depthScale = 0;
+    const bool depth = m_chamberMetrics.dim >= 3;
+    if (depth) {
+        proj.depthScale = static_cast<double>(pixscale * *(corner[2] / m_scale)) / phys::RenderQuantMax;
+    }
+    proj.focal = PerspectiveFocal * std::max(proj.centerX, proj.centerY) * 2;
+    proj.perspective = m_camera == Camera::Perspective && depth;
+    proj.shaded = m_camera != Camera::Flat && depth;
+    return proj;
+}
+
+ChamberDisplayer::Splat ChamberDisplayer::project(const phys::RenderAtom& atom, const Projection& proj) {
+    double x = atom.pos[0] * proj.xScale;
+    double y = atom.pos[1] * proj.yScale;
+    double radius = atom.radius * proj.xScale;
+    if (proj.perspective) {
+        // The camera looks from beyond the far Z wall, so big Z is close.
+        double factor = proj.focal / (proj.focal + (phys::RenderQuantMax - atom.pos[2]) * proj.depthScale);
+        x = proj.centerX + (x - proj.centerX) * factor;
+        y = proj.centerY + (y - proj.centerY) * factor;
+        radius *= factor;
+    }
+    uint32_t shade = proj.shaded ? 128 + (uint32_t{atom.pos[2]} * 128 >> 16) : 256;
+    return {static_cast<int>(x), static_cast<int>(y), std::max(1, static_cast<int>(radius)), shade};
+}
+
+QRgb ChamberDisplayer::applyShade(QRgb color, uint32_t shade) {
+    if (shade >= 256)
+        return color;
+    return qRgb(static_cast<int>(qRed  (color) * shade >> 8),
+                static_cast<int>(qGreen(color) * shade >> 8),
+                static_cast<int>(qBlue (color) * shade >> 8));
+}
+
+void ChamberDisplayer::drawAtoms(QPainter& painter, phys::num_t pixscale) {
+    QPen pen;
+    pen.setWidth(3);
+    QBrush brush(Qt::SolidPattern);
+    const Projection proj = makeProjection(pixscale);
+    size_t i = 0;
+    for (auto& atom : m_chamberMetrics.atoms) {
+        if(i++ > 5'000)
+            break;
+        Splat splat = project(atom, proj);
+        QColor color = QColor(applyShade(getColor(atom.color).rgb(), splat.shade));
+        brush.setColor(color);
+        pen.setColor(color);
+        painter.setPen(pen);
+        painter.setBrush(brush);
+
+        painter.drawEllipse(splat.x - splat.radius, splat.y - splat.radius, 2 * splat.radius, 2 * splat.radius);
+    }
+}
+
+void ChamberDisplayer::rasterizeAtoms(phys::num_t pixscale) {
+    const int width  = rect().width();
+    const int height = rect().height();
+    if (m_frame.width() != width || m_frame.height() != height) {
+        m_frame = QImage(width, height, QImage::Format_RGB32);
+    }
+    m_frame.fill(qRgb(255, 255, 255));
+
+    const auto& atoms = m_chamberMetrics.atoms;
+    if (atoms.empty() || width <= 0 || height <= 0)
+        return;
+
+    std::array<QRgb, 256> palette;
+    for (size_t key = 0; key < palette.size(); ++key) {
+        palette[key] = getColor(static_cast<uint8_t>(key)).rgb();
+    }
+
+    const Projection proj = makeProjection(pixscale);
+
+    // Every band owns its rows of the frame, so atoms are splatted without locks and
+    // in the same order as they come in the buffer, far ones first when depth sorted.
+    const int nBands = std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    const int bandHeight = (height + nBands - 1) / nBands;
+    const size_t bands = static_cast<size_t>((height + bandHeight - 1) / bandHeight);
+    const size_t chunks = phys::StepSize;
+    auto bandsOf = [height, bandHeight] (const Splat& splat, size_t& first, size_t& last) {
+        const int top = std::max(0, splat.y - splat.radius);
+        const int bottom = std::min(height - 1, splat.y + splat.radius);
+        first = static_cast<size_t>(top / bandHeight);
+        last = static_cast<size_t>(bottom / bandHeight);
+        return top <= bottom;
+    };
+
+    // Atoms are projected once, each chunk counts its splats per band. Offsets are laid out
+    // band by band and chunk by chunk, so a band's splats stay in buffer order.
+    m_splats.resize(atoms.size());
+    std::vector<size_t> offsets(bands * chunks + 1, 0);
+    phys::parallelChunks(atoms.size(), [&] (size_t chunk, size_t l, size_t r) {
+        for (size_t i = l; i < r; ++i) {
+            m_splats[i] = project(atoms[i], proj);
+            size_t first, last;
+            if (bandsOf(m_splats[i], first, last)) {
+                for (size_t band = first; band <= last; ++band) {
+                    offsets[band * chunks + chunk + 1]++;
+                }
+            }
+        }
+    }, "rasterChunk");
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<size_t> bandStart(bands + 1);
+    for (size_t band = 0; band <= bands; ++band) {
+        bandStart[band] = offsets[band * chunks];
+    }
+
+    // Same chunks as the first pass, each one fills its own slots.
+    m_bandSplats.resize(offsets.back());
+    phys::parallelChunks(atoms.size(), [&] (size_t chunk, size_t l, size_t r) {
+        for (size_t i = l; i < r; ++i) {
+            size_t first, last;
+            if (bandsOf(m_splats[i], first, last)) {
+                for (size_t band = first; band <= last; ++band) {
+                    m_bandSplats[offsets[band * chunks + chunk]++] = static_cast<uint32_t>(i);
+                }
+            }
+        }
+    }, "rasterChunk");
+
+    QFutureSynchronizer<void> synchronizer = {};
+    for (size_t band = 0; band < bands; ++band) {
+        const int top = static_cast<int>(band) * bandHeight;
+        synchronizer.addFuture(QtConcurrent::run(
+            [this, &atoms, &palette, &bandStart, width, band, top, bottom = std::min(height, top + bandHeight)] () {
+                for (size_t k = bandStart[band]; k < bandStart[band + 1]; ++k) {
+                    const size_t i = m_bandSplats[k];
+                    const Splat& splat = m_splats[i];
+                    const int radius = splat.radius;
+                    const int x = splat.x;
+                    const int y = splat.y;
+                    QRgb color = applyShade(palette[atoms[i].color], splat.shade);
+                    for (int row = std::max(top, y - radius); row <= std::min(bottom - 1, y + radius); ++row) {
+                        int halfWidth = static_cast<int>(std::sqrt(radius * radius - (row - y) * (row - y)));
+                        QRgb* line = reinterpret_cast<QRgb*>(m_frame.scanLine(row));
+                        for (int col = std::max(0, x - halfWidth); col <= std::min(width - 1, x + halfWidth); ++col) {
+                            line[col] = color;
+                        }
+                    }
+                }
+            }
+        ));
+    }
+    synchronizer.waitForFinished();
+}
+
+void ChamberDisplayer::drawField(QPainter& painter, phys::num_t pixscale) {
+    const int chamberWidth  = static_cast<int>(pixscale * *(m_chamberMetrics.chamberCorner.X() / m_scale));
+    const int chamberHeight = static_cast<int>(pixscale * *(m_chamberMetrics.chamberCorner.Y() / m_scale));
+    // The engine bins for the next frame at the current widget size.
+    m_chamberMetrics.render.fieldSize = {static_cast<size_t>(std::max(1, chamberWidth  / FieldBinPixels)),
+                                         static_cast<size_t>(std::max(1, chamberHeight / FieldBinPixels))};
+
+    const auto& field = m_chamberMetrics.field;
+    const auto& counts = m_chamberMetrics.fieldCounts;
+    const int width  = m_fieldFrame.width();
+    const int height = m_fieldFrame.height();
+    if (field.empty() || field.size() != static_cast<size_t>(width) * static_cast<size_t>(height) ||
+        counts.size() != field.size()) {
+        m_fieldFrame = QImage(static_cast<int>(m_chamberMetrics.render.fieldSize[0]),
+                              static_cast<int>(m_chamberMetrics.render.fieldSize[1]), QImage::Format_RGB32);
+        m_fieldFrame.fill(qRgb(255, 255, 255));
+        return;
+    }
+
+    float maxValue = 1.f;
+    if (m_viewMode != ViewMode::SpeciesField) {
+        maxValue = *std::max_element(field.begin(), field.end());
+    }
+
+    for (int y = 0; y < height; ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(m_fieldFrame.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const size_t bin = static_cast<size_t>(y) * width + x;
+            const float value = field[bin];
+            // Empty bins are background, a species share of 0 there would read as pure light gas.
+            if (counts[bin] == 0.f || (value <= 0.f && m_viewMode != ViewMode::SpeciesField)) {
+                line[x] = qRgb(255, 255, 255);
+                continue;
+            }
+            int hue = static_cast<int>(200.f * std::min(1.f, value / maxValue));
+            line[x] = QColor::fromHsv(200 - hue, 250, 250).rgb();
+        }
+    }
+    painter.drawImage(QRect(0, 0, chamberWidth, chamberHeight), m_fieldFrame);
+}
+
+void ChamberDisplayer::drawHistogram(QPainter& painter) {
+    const auto& hist = m_chamberMetrics.velocities;
+    if (hist.count == 0)
+        return;
+
+    const int bins = static_cast<int>(phys::VelocityHistogram::Bins);
+    const int barWidth = 4;
+    const int plotHeight = 128;
+    const int left = rect().width() - bins * barWidth - 10;
+    const int bottom = rect().height() - 10;
+
+    phys::num_t top{1};
+    for (size_t i = 0; i < phys::VelocityHistogram::Bins; ++i) {
+        top = std::max(top, std::max(phys::num_t{hist.speed[i]}, hist.maxwellSpeed[i]));
+    }
+    auto barHeight = [&top, plotHeight] (phys::num_t value) {
+        return static_cast<int>(value / top * phys::num_t{plotHeight});
+    };
+
+    painter.fillRect(left, bottom - plotHeight, bins * barWidth, plotHeight, QColor(255, 255, 255, 200));
+    for (int i = 0; i < bins; ++i) {
+        int h = barHeight(phys::num_t{hist.speed[i]});
+        painter.fillRect(left + i * barWidth, bottom - h, barWidth - 1, h, Qt::gray);
+    }
+
+    QPen pen(Qt::red);
+    pen.setWidth(2);
+    painter.setPen(pen);
+    for (int i = 1; i < bins; ++i) {
+        painter.drawLine(QPoint{left + (i - 1) * barWidth + barWidth / 2, bottom - barHeight(hist.maxwellSpeed[i - 1])},
+                         QPoint{left + i * barWidth + barWidth / 2, bottom - barHeight(hist.maxwellSpeed[i])});
+    }
+}
+
+uint8_t ChamberDisplayer::colorKey(const phys::GasAtom<phys::MaxDim>& atom, phys::SpeciesId species) const {
+    if (m_chamberMetrics.render.key == phys::RenderKey::Species)
+        return species;
+
+    phys::num_t key = *(atom.getKinetic() / phys::RenderHeatQuantum);
+    return key < phys::num_t{0xff} ? static_cast<uint8_t>(key) : 0xff;
+}
+
+QColor ChamberDisplayer::getColor(uint8_t key) const {
     switch (m_colorPolicy) {
 
     case ColorPolicy::SingleColor:
         return Qt::gray;
     
     case ColorPolicy::HeatColor: {
-        int hue = std::min(200, static_cast<int>(*atom.getKinetic() * 0.2e23));
+        int hue = std::min(200, static_cast<int>(key));
         return QColor::fromHsv(200 - hue, 250, 250);
     }
-    case ColorPolicy::MassColor:
-        if(atom.getMass() == phys::num_t{131}  * phys::consts::Dalton)
-            return Qt::magenta;
+    case ColorPolicy::MassColor: {
+        // Key is the species id, in the order the species were first added.
+        static const std::array<QColor, 2> first = {Qt::blue, Qt::magenta};
+        if (key < first.size())
+            return first[key];
 
-        if(atom.getMass() == phys::num_t{4}  * phys::consts::Dalton)
-            return Qt::blue;
-
-        return Qt::black;
+        return QColor::fromHsv((key * 47) % 360, 250, 200);
+    }
     }
     return Qt::magenta;
 }
@@ -2,11 +2,13 @@
 #define UNIVERSEDISPLAYER_HPP
 
 #include "chamber.hpp"
+#include <QImage>
 #include <QVector>
 #include <QWidget>
 
 class QSpinBox;
 class QPushButton;
+class QPainter;
 
 class ChamberDisplayer : public QWidget {
     Q_OBJECT
@@ -28,10 +30,39 @@ public:
 
     ColorPolicy m_colorPolicy = ColorPolicy::HeatColor;
 
+    enum class ViewMode {
+        Atoms = 0,
+        DensityField = 1,
+        KineticField = 2,
+        SpeciesField = 3,
+    };
+
+    ViewMode m_viewMode = ViewMode::Atoms;
+
+    void setViewMode(ViewMode newViewMode);
+
+    enum class Camera {
+        Flat = 0,         // buffer order, Z ignored
+        Orthographic = 1, // depth sorted and shaded
+        Perspective = 2,  // depth sorted, shaded and scaled by distance
+    };
+
+    Camera m_camera = Camera::Orthographic;
+
+    void setCamera(Camera newCamera);
 
     void setColorPolicy(ColorPolicy newColorPolicy);
 
 private:
+    static const int FieldBinPixels = 2;
+    /// Perspective camera distance from the front wall, in chamber sizes.
+    static constexpr double PerspectiveFocal = 2.;
+
+    QImage m_frame;
+    QImage m_fieldFrame;
+    bool m_raster = true;
+    bool m_showHistogram = false;
+
     std::array<std::pair<QPoint, QColor>, 1024> m_record;
     std::size_t m_recordIdx = 0;
     std::size_t m_followIdx = 0;
@@ -46,7 +77,41 @@ private:
 
     void rescale();
 
-    QColor getColor(const phys::GasAtom&) const;
+    uint8_t colorKey(const phys::GasAtom<phys::MaxDim>&, phys::SpeciesId) const;
+
+    QColor getColor(uint8_t key) const;
+
+    struct Projection {
+        double xScale, yScale;   // pixels per quantum
+        double centerX, centerY; // perspective vanishing point
+        double depthScale;       // distance from the front wall per Z quantum, pixels
+        double focal;            // camera distance from the front wall, pixels
+        bool perspective;
+        bool shaded;
+    };
+
+    struct Splat {
+        int x, y, radius;
+        uint32_t shade; // 0..256
+    };
+
+    // Scratch of rasterizeAtoms(): every atom projected once, then the splats of every band.
+    std::vector<Splat> m_splats;
+    std::vector<uint32_t> m_bandSplats;
+
+    Projection makeProjection(phys::num_t pixscale) const;
+
+    static Splat project(const phys::RenderAtom& atom, const Projection& proj);
+
+    static QRgb applyShade(QRgb color, uint32_t shade);
+
+    void drawAtoms(QPainter& painter, phys::num_t pixscale);
+
+    void rasterizeAtoms(phys::num_t pixscale);
+
+    void drawField(QPainter& painter, phys::num_t pixscale);
+
+    void drawHistogram(QPainter& painter);
 
 public slots:
     void paintEvent(QPaintEvent* event) override;
@@ -54,6 +119,12 @@ public slots:
     void setFollowIdx(int newFollowIdx);
 
     void setFollow(bool newFollow);
+
+    void setRaster(bool newRaster);
+
+    void setSampleSize(int newSampleSize);
+
+    void setShowHistogram(bool newShowHistogram);
 };
 
 #endif // UNIVERSEDISPLAYER_HPP
@@ -1,12 +1,109 @@
 #include "mainwindow.hpp"
+#include "memory.hpp"
+#include "trace.hpp"
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QDebug>
 #include <QLoggingCategory>
+#include <fstream>
 
 int main(int argc, char* argv[]) {
     QApplication a(argc, argv);
-    MainWindow w;
+    if (qEnvironmentVariableIsSet("MKT_HUGE_PAGES")) {
+        phys::setHugePages(true);
+    }
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption dimOption("dim", "Chamber dimension, 2 or 3.", "dim", "3");
+    parser.addOption(dimOption);
+    QCommandLineOption countersOption("counters", "Append step counters to the file as JSON lines.", "file");
+    parser.addOption(countersOption);
+    QCommandLineOption traceOption("trace", "Record phases and chunks of every thread, write a Chrome trace on exit.", "file");
+    parser.addOption(traceOption);
+    QCommandLineOption checkOption("check", "Check energy, momentum, walls and overlaps every given number of steps.", "steps");
+    parser.addOption(checkOption);
+    QCommandLineOption auditOption("audit", "Compare the broad phase with a brute-force search every given number of steps.", "steps");
+    parser.addOption(auditOption);
+    QCommandLineOption msdOption("msd", "Sample the mean squared displacement every given number of steps.", "steps");
+    parser.addOption(msdOption);
+    QCommandLineOption vacfOption("vacf", "Sample the velocity autocorrelation every given number of steps.", "steps");
+    parser.addOption(vacfOption);
+    QCommandLineOption rdfOption("rdf", "Sample the radial distribution function every given number of steps.", "steps");
+    parser.addOption(rdfOption);
+    QCommandLineOption profileOption("profile", "Sample species concentrations along X every given number of steps.", "steps");
+    parser.addOption(profileOption);
+    QCommandLineOption profileLogOption("profile-log", "Append the concentration profiles to the file as JSON lines.", "file");
+    parser.addOption(profileLogOption);
+    QCommandLineOption thermostatOption("thermostat", "Heat bath: rescale or andersen, see --temperature.", "mode");
+    parser.addOption(thermostatOption);
+    QCommandLineOption temperatureOption("temperature", "Target temperature of the thermostat.", "kelvin", "300");
+    parser.addOption(temperatureOption);
+    QCommandLineOption rampOption("ramp", "Steps the thermostat moves the temperature to the target over.", "steps", "0");
+    parser.addOption(rampOption);
+    QCommandLineOption bathRateOption("bath-rate", "Chance of an atom to collide with the Andersen bath in a step.", "rate", "0.01");
+    parser.addOption(bathRateOption);
+    parser.process(a);
+
+    size_t dim = parser.value(dimOption).toUInt();
+    if (dim != 2 && dim != 3) {
+        qWarning() << "Unsupported dimension" << dim << ", using 3";
+        dim = 3;
+    }
+
+    MainWindow w(dim);
+    if (parser.isSet(countersOption)) {
+        w.logCounters(parser.value(countersOption));
+    }
+    if (parser.isSet(checkOption)) {
+        w.checkInvariants(parser.value(checkOption).toUInt());
+    }
+    if (parser.isSet(auditOption)) {
+        w.auditBroadPhase(parser.value(auditOption).toUInt());
+    }
+    if (parser.isSet(msdOption)) {
+        w.trackDiffusion(parser.value(msdOption).toUInt());
+    }
+    if (parser.isSet(vacfOption)) {
+        w.correlateVelocities(parser.value(vacfOption).toUInt());
+    }
+    if (parser.isSet(rdfOption)) {
+        w.samplePairDistribution(parser.value(rdfOption).toUInt());
+    }
+    if (parser.isSet(profileOption)) {
+        w.sampleProfile(parser.value(profileOption).toUInt());
+    }
+    if (parser.isSet(profileLogOption)) {
+        w.logProfile(parser.value(profileLogOption));
+    }
+    if (parser.isSet(thermostatOption)) {
+        phys::Thermostat thermostat;
+        const QString mode = parser.value(thermostatOption);
+        if (mode == "rescale") {
+            thermostat.mode = phys::ThermostatMode::Rescale;
+        } else if (mode == "andersen") {
+            thermostat.mode = phys::ThermostatMode::Andersen;
+        } else {
+            qWarning() << "Unknown thermostat" << mode;
+        }
+        thermostat.temperature = phys::Temperature{parser.value(temperatureOption).toDouble()};
+        thermostat.rampSteps = parser.value(rampOption).toUInt();
+        thermostat.collisionRate = parser.value(bathRateOption).toDouble();
+        w.setThermostat(thermostat);
+    }
+    if (parser.isSet(traceOption)) {
+        phys::setTracing(true);
+    }
     w.show();
-    return a.exec();
+    int code = a.exec();
+
+    // The physics thread and its chunks are joined first, no span is written while the rings are read.
+    w.finishSimulation();
+    if (parser.isSet(traceOption)) {
+        phys::setTracing(false);
+        std::ofstream trace(parser.value(traceOption).toStdString());
+        phys::writeTrace(trace);
+    }
+    return code;
 }
@@ -3,57 +3,28 @@
 
 #include "physconstants.hpp"
 #include "physicsthread.hpp"
+#include "presets.hpp"
 #include <QDebug>
 #include <QTimer>
 
-const constexpr phys::Time Step = 5e-14_sec;
-const constexpr phys::Length XSize = 5e-7_m;
-const constexpr phys::Length YSize = 5e-7_m;
-const constexpr phys::Length ZSize = 1e-7_m;
+const constexpr phys::Time Step = phys::PresetStep;
+const constexpr phys::Preset Preset = phys::Preset::Random;
 
-#define PRESET 1
-
-MainWindow::MainWindow(QWidget* parent)
+MainWindow::MainWindow(size_t dim, QWidget* parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-#if PHYS_UNIVERSE_DIM == 3
-    , m_chamber({XSize, YSize, ZSize})
-#else
-    , m_chamber({XSize, YSize})
-#endif
-    , m_physThread(new PhysicsThread(m_chamber, this)) {
+    , m_chamber(phys::makePreset(Preset, dim, phys::presetAtoms(Preset)))
+    , m_physThread(new PhysicsThread(*m_chamber, this)) {
 
     m_cd = new ChamberDisplayer(m_chamberMetrics, this);
     m_cd->setGeometry(rect());
-    m_cd->setScale(XSize);
-    //    m_chamber.fillRandom(400, 1e-7_m / 1_sec, phys::num_t{4} * phys::consts::Dalton,
+    m_cd->setScale(phys::presetCorner(Preset, dim).X());
+    //    m_chamber->fillRandom(400, 1e-7_m / 1_sec, phys::num_t{4} * phys::consts::Dalton,
     //    31e-12_m);
 
-#if PRESET == 0
-    m_chamber.fillRandomAxis(100'000, 1e3_m / 1_sec, phys::num_t{4} * phys::consts::Dalton, 31e-12_m);
-
-#elif PRESET == 1
-    m_chamber.fillRandom(100'000, 4e3_m / 1_sec, phys::num_t{4} * phys::consts::Dalton, 31e-12_m);
-
-#elif PRESET == 2
-
-#if PHYS_UNIVERSE_DIM == 3
-    phys::num_t downscale = 0.05;
-    m_chamber.setWalls({XSize * downscale, YSize * downscale, ZSize * downscale});
-#else
-    phys::num_t downscale = 1.;
-    m_chamber.setWalls({XSize * downscale, YSize * downscale});
-#endif
-    m_cd->setScale(XSize * downscale);
-
-    m_chamber.fillRandomHalf(2'500, 5e3_m / 1_sec, phys::num_t{4}   * phys::consts::Dalton, 31e-12_m, 0);
-    m_chamber.fillRandomHalf(2'500, 3e2_m / 1_sec, phys::num_t{131} * phys::consts::Dalton, 108e-12_m, 1);
-
-    m_chamber.fillRandomHalf(50'000, 5e3_m / 1_sec, phys::num_t{4}   * phys::consts::Dalton, 31e-12_m, 0);
-    m_chamber.fillRandomHalf(50'000, 3e2_m / 1_sec, phys::num_t{131} * phys::consts::Dalton, 108e-12_m, 1);
-// 180 kPa 1.1 MPa
-    m_cd->setColorPolicy(ChamberDisplayer::ColorPolicy::MassColor);
-#endif
+    if constexpr (Preset == phys::Preset::TwoGases) {
+        m_cd->setColorPolicy(ChamberDisplayer::ColorPolicy::MassColor);
+    }
 
     m_timer = new QTimer(this);
     m_timer->setInterval(1000 / 60); // 60 fps
@@ -63,22 +34,29 @@ MainWindow::MainWindow(QWidget* parent)
 
     m_elapsed.start();
 
-    m_chamber.setDT(Step);
     m_physThread->setPeriod(0);
 
     ui->setupUi(this);
 
-    #if PRESET == 2
+    if constexpr (Preset == phys::Preset::TwoGases) {
         ui->colorSelector->setCurrentIndex(2);
-    #endif
+    }
 
     connect(ui->startButton, SIGNAL(toggled(bool)), this, SLOT(toggleSimulation(bool)));
     connect(ui->timerBox, SIGNAL(valueChanged(int)), this, SLOT(setSimulationSpeed(int)));
     connect(ui->volumeSlider, SIGNAL(valueChanged(int)), this, SLOT(setXLength(int)));
     connect(ui->holeBox, SIGNAL(toggled(bool)), this, SLOT(openHole(bool)));
+    connect(ui->periodicBox, SIGNAL(toggled(bool)), this, SLOT(setPeriodic(bool)));
+    connect(ui->ccdBox, SIGNAL(toggled(bool)), this, SLOT(setContinuous(bool)));
+    connect(ui->windowBox, SIGNAL(valueChanged(int)), this, SLOT(setPressureWindow(int)));
     connect(ui->followBox, SIGNAL(toggled(bool)), m_cd, SLOT(setFollow(bool)));
     connect(ui->chooseAtom, SIGNAL(valueChanged(int)), m_cd, SLOT(setFollowIdx(int)));
+    connect(ui->rasterBox, SIGNAL(toggled(bool)), m_cd, SLOT(setRaster(bool)));
+    connect(ui->sampleBox, SIGNAL(valueChanged(int)), m_cd, SLOT(setSampleSize(int)));
     connect(ui->colorSelector, SIGNAL(currentIndexChanged(int)), this, SLOT(setColoring(int)));
+    connect(ui->viewSelector, SIGNAL(currentIndexChanged(int)), this, SLOT(setView(int)));
+    connect(ui->histogramBox, SIGNAL(toggled(bool)), m_cd, SLOT(setShowHistogram(bool)));
+    connect(ui->cameraSelector, SIGNAL(currentIndexChanged(int)), this, SLOT(setCamera(int)));
 
     m_eDisplays[0] = ui->eDisplay1;
     m_eDisplays[1] = ui->eDisplay2;
@@ -95,6 +73,8 @@ MainWindow::MainWindow(QWidget* parent)
 }
 
 MainWindow::~MainWindow() {
+    // The thread is a child of the window, it would outlive the chamber it steps.
+    m_physThread->finish();
     delete ui;
 }
 
@@ -103,6 +83,10 @@ void MainWindow::resizeEvent(QResizeEvent* event) {
     m_cd->setGeometry(rect());
 }
 
+void MainWindow::finishSimulation() {
+    m_physThread->finish();
+}
+
 void MainWindow::toggleSimulation(bool run) {
     if (run) {
         m_physThread->cont();
@@ -116,6 +100,15 @@ void MainWindow::setSimulationSpeed(int x) {
     m_physThread->setPeriod(x);
 }
 
+// Pressure of a 3D chamber is in Pa, of a 2D one in N/m.
+static void printPressure(QTextStream& ss, size_t dim, phys::num_t pressure) {
+    if (dim == 3) {
+        ss << phys::Pressure<3>{pressure};
+    } else {
+        ss << phys::Pressure<2>{pressure};
+    }
+}
+
 void MainWindow::updateMetrics() {
     if(ui->timerBox->value() == -1) {
         return;
@@ -124,13 +117,13 @@ void MainWindow::updateMetrics() {
     m_physThread->acquireMetrics(m_chamberMetrics);
     m_cd->update();
 
-    ui->chooseAtom->setMaximum(m_chamberMetrics.atoms.size());
+    ui->chooseAtom->setMaximum(m_chamberMetrics.nAtoms);
     QString str;
     QTextStream ss(&str);
 
     phys::Energy totalE{};
 
-    for (size_t i = 0; i < phys::UniverseDim; i++) {
+    for (size_t i = 0; i < m_chamberMetrics.dim; i++) {
         ss << m_chamberMetrics.kineticEnergy[i];
         totalE += m_chamberMetrics.kineticEnergy[i];
         m_eDisplays[i]->setText(str);
@@ -141,50 +134,188 @@ void MainWindow::updateMetrics() {
     ui->eDisplayTotal->setText(str);
     str.clear();
 
-    ss << totalE * (phys::num_t{2. / 3.} / phys::num_t{m_chamberMetrics.atoms.size()}) /
+    ss << totalE * (phys::num_t{2. / static_cast<double>(m_chamberMetrics.dim)} / phys::num_t{m_chamberMetrics.nAtoms}) /
               phys::consts::k;
     ui->tempDIsplay->setText(str);
     str.clear();
 
-    for (size_t i = 0; i < 2 * phys::UniverseDim; i++) {
-        ss << m_chamberMetrics.pressure[i];
+    for (size_t i = 0; i < 2 * m_chamberMetrics.dim; i++) {
+        printPressure(ss, m_chamberMetrics.dim, m_chamberMetrics.pressure[i]);
         m_pDisplays[i]->setText(str);
         str.clear();
     }
 
-    phys::Length freeFlight{};
-    for(size_t i = 0; i < m_chamberMetrics.atoms.size(); ++i) {
-        freeFlight += m_chamberMetrics.atoms[i].getFreeFlight(m_chamberMetrics.time);
-    }
-
-    ss << freeFlight;
-    ui->freeFlightDisplay->setText(str);
+    ss << m_chamberMetrics.followed.getKinetic() * phys::num_t{2. / static_cast<double>(m_chamberMetrics.dim)} / phys::consts::k;
+    ui->avgEDisplay->setText(str);
     str.clear();
 
-    ss << m_chamberMetrics.atoms[ui->chooseAtom->value()].getAverageEnergy(m_chamberMetrics.time) * phys::num_t{2./3.} / phys::consts::k;
-    ui->avgEDisplay->setText(str);
+
+    ss << m_chamberMetrics.velocities.deviation * phys::num_t{100} << " % @ " << m_chamberMetrics.velocities.temperature;
+    ui->maxwellDisplay->setText(str);
     str.clear();
 
+    for (const auto& species : m_chamberMetrics.species) {
+        ss << *(species.species.mass / phys::consts::Dalton) << " Da: " << species.temperature << ", ";
+        printPressure(ss, m_chamberMetrics.dim, species.pressure);
+        ss << "; ";
+    }
+    ui->speciesDisplay->setText(str);
+    str.clear();
 
     double ticks = static_cast<double>(*(m_chamberMetrics.time / Step));
     ui->tps->setValue(1000 * ticks / m_elapsed.elapsed());
+
+    const phys::StepCounters& counters = m_chamberMetrics.counters;
+    for (size_t phase = 0; phase < phys::StepPhases; ++phase) {
+        ss << phys::phaseName(static_cast<phys::StepPhase>(phase)) << ": " << counters.phaseSeconds[phase] * 1e3 << " ms ";
+    }
+    ss << "\npairs: " << counters.pairsTested << ", collisions: " << counters.collisionsFound << " found, "
+       << counters.collisionsResolved << " resolved"
+       << "\ncells: " << counters.occupancy.cells << " of " << counters.occupancy.cellSize << ", atoms per cell: " << counters.occupancy.mean << " mean, "
+       << counters.occupancy.max << " max"
+       << "\ndeleted: " << counters.deleted << ", allocated: " << counters.allocated.bytes << " B"
+       << ", invariant violations: " << m_chamberMetrics.invariantViolations;
+    if (m_chamberMetrics.audit.windows != 0) {
+        ss << "\nbroad phase missed " << m_chamberMetrics.audit.missRate() * phys::num_t{100} << " % of "
+           << m_chamberMetrics.audit.overlaps << " overlaps";
+    }
+    if (!m_chamberMetrics.msd.species.empty()) {
+        ss << "\nD:";
+        for (size_t id = 0; id < m_chamberMetrics.species.size() && id < m_chamberMetrics.msd.species.size(); ++id) {
+            ss << ' ' << *(m_chamberMetrics.species[id].species.mass / phys::consts::Dalton) << " Da "
+               << m_chamberMetrics.msd.species[id].diffusion << " m^2/s";
+        }
+    }
+    if (!m_chamberMetrics.vacf.species.empty()) {
+        ss << "\nD (Green-Kubo):";
+        for (size_t id = 0; id < m_chamberMetrics.species.size() && id < m_chamberMetrics.vacf.species.size(); ++id) {
+            ss << ' ' << *(m_chamberMetrics.species[id].species.mass / phys::consts::Dalton) << " Da "
+               << m_chamberMetrics.vacf.species[id].diffusion << " m^2/s";
+        }
+    }
+    const phys::PairDistribution& rdf = m_chamberMetrics.rdf;
+    if (rdf.samples != 0) {
+        const size_t peak = static_cast<size_t>(std::max_element(rdf.g.begin(), rdf.g.end()) - rdf.g.begin());
+        ss << "\ng(r) peak: " << rdf.g[peak] << " at " << rdf.range * phys::num_t{(peak + 0.5) / phys::PairDistribution::Bins}
+           << ", at " << rdf.range << ": " << rdf.g.back();
+    }
+    const phys::ConcentrationProfile& profile = m_chamberMetrics.profile;
+    if (!profile.diffusion.empty()) {
+        ss << "\nD (Fick):";
+        for (size_t id = 0; id < m_chamberMetrics.species.size() && id < profile.diffusion.size(); ++id) {
+            ss << ' ' << *(m_chamberMetrics.species[id].species.mass / phys::consts::Dalton) << " Da "
+               << profile.diffusion[id] << " m^2/s";
+        }
+    }
+    const phys::ThermostatStats& thermostat = m_chamberMetrics.thermostat;
+    if (thermostat.mode != phys::ThermostatMode::Off) {
+        ss << "\nthermostat " << phys::thermostatName(thermostat.mode) << ": " << thermostat.temperature << " of "
+           << thermostat.target << ", heat " << thermostat.heat << ", bath collisions " << thermostat.collisions;
+    }
+    ui->countersDisplay->setPlainText(str);
+    str.clear();
+
+    if (m_countersLog.is_open() && counters.step != m_loggedStep) {
+        phys::writeJson(m_countersLog, counters);
+        m_loggedStep = counters.step;
+    }
+    if (m_profileLog.is_open() && !profile.atoms.empty() && profile.step != m_loggedProfileStep) {
+        phys::writeJson(m_profileLog, profile);
+        m_loggedProfileStep = profile.step;
+    }
+}
+
+void MainWindow::checkInvariants(size_t period)
+{
+    m_physThread->setInvariantPeriod(period);
+}
+
+void MainWindow::auditBroadPhase(size_t period)
+{
+    m_physThread->setAuditPeriod(period);
+}
+
+void MainWindow::trackDiffusion(size_t period)
+{
+    m_physThread->setMsdPeriod(period);
+}
+
+void MainWindow::correlateVelocities(size_t period)
+{
+    m_physThread->setVacfPeriod(period);
+}
+
+void MainWindow::samplePairDistribution(size_t period)
+{
+    m_physThread->setRdfPeriod(period);
+}
+
+void MainWindow::sampleProfile(size_t period)
+{
+    m_physThread->setProfilePeriod(period);
+}
+
+void MainWindow::setThermostat(const phys::Thermostat& thermostat)
+{
+    m_physThread->setThermostat(thermostat);
+}
+
+void MainWindow::logProfile(const QString& path)
+{
+    m_profileLog.open(path.toStdString(), std::ios::app);
+    if (!m_profileLog) {
+        qWarning() << "Cannot open" << path;
+    }
+}
+
+void MainWindow::logCounters(const QString& path)
+{
+    m_countersLog.open(path.toStdString(), std::ios::app);
+    if (!m_countersLog) {
+        qWarning() << "Cannot open" << path;
+    }
 }
 
 void MainWindow::setXLength(int scale)
 {
-    #if PRESET == 2 //FIXME: CLUTCH
-    m_chamber.setXLength(XSize * phys::num_t{0.05} * phys::num_t{static_cast<double>(scale) / ui->volumeSlider->maximum()});
-    #else
-    m_chamber.setXLength(XSize * phys::num_t{static_cast<double>(scale) / ui->volumeSlider->maximum()});
-    #endif
+    phys::Length xSize = phys::presetCorner(Preset, m_chamber->dim()).X();
+    m_physThread->setXLength(xSize * phys::num_t{static_cast<double>(scale) / ui->volumeSlider->maximum()});
+}
+
+void MainWindow::setPressureWindow(int picoseconds)
+{
+    m_physThread->setPressureWindow(phys::Time{phys::Pico * picoseconds});
 }
 
 void MainWindow::openHole(bool open)
 {
-    m_chamber.openHole(open);
+    m_physThread->openHole(open);
+}
+
+void MainWindow::setPeriodic(bool periodic)
+{
+    // X keeps its walls: the hole and the volume slider work on them.
+    for (size_t axis = 1; axis < m_chamber->dim(); ++axis) {
+        m_physThread->setBoundary(axis, periodic ? phys::Boundary::Periodic : phys::Boundary::Wall);
+    }
+}
+
+void MainWindow::setContinuous(bool continuous)
+{
+    m_physThread->setContinuousCollisions(continuous);
 }
 
 void MainWindow::setColoring(int x)
 {
     m_cd->setColorPolicy(static_cast<ChamberDisplayer::ColorPolicy>(x));
 }
+
+void MainWindow::setView(int x)
+{
+    m_cd->setViewMode(static_cast<ChamberDisplayer::ViewMode>(x));
+}
+
+void MainWindow::setCamera(int x)
+{
+    m_cd->setCamera(static_cast<ChamberDisplayer::Camera>(x));
+}
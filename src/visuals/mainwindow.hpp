@@ -4,7 +4,9 @@
 #include "chamberdisplayer.hpp"
 #include <QMainWindow>
 #include <array>
+#include <memory>
 #include <QElapsedTimer>
+#include <fstream>
 
 namespace Ui {
 class MainWindow;
@@ -18,11 +20,41 @@ class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    explicit MainWindow(QWidget* parent = nullptr);
+    explicit MainWindow(size_t dim = phys::MaxDim, QWidget* parent = nullptr);
     ~MainWindow() override;
 
     void resizeEvent(QResizeEvent* event) override;
 
+    /// Appends the step counters to the file as JSON lines, one per metrics update.
+    void logCounters(const QString& path);
+
+    /// Checks conservation laws, walls and overlaps every period steps, 0 turns the checks off.
+    void checkInvariants(size_t period);
+
+    /// Compares the broad phase with a brute-force search every period steps, 0 turns it off.
+    void auditBroadPhase(size_t period);
+
+    /// Samples the mean squared displacement every period steps, 0 turns it off.
+    void trackDiffusion(size_t period);
+
+    /// Samples the velocity autocorrelation every period steps, 0 turns it off.
+    void correlateVelocities(size_t period);
+
+    /// Samples g(r) every period steps, 0 turns it off.
+    void samplePairDistribution(size_t period);
+
+    /// Samples the concentration profile along X every period steps, 0 turns it off.
+    void sampleProfile(size_t period);
+
+    /// Appends the concentration profile to the file as JSON lines, one per new sample shown.
+    void logProfile(const QString& path);
+
+    /// Heat bath of the atoms from the next step on.
+    void setThermostat(const phys::Thermostat& thermostat);
+
+    /// Stops the physics thread for good, nothing touches the chamber afterwards.
+    void finishSimulation();
+
 private:
     ChamberDisplayer* m_cd;
     Ui::MainWindow* ui;
@@ -34,13 +66,18 @@ private:
     std::array<QLineEdit*, 3> m_eDisplays;
     std::array<QLineEdit*, 6> m_pDisplays;
 
-    phys::Chamber m_chamber;
+    std::unique_ptr<phys::Chamber> m_chamber;
     phys::Chamber::Metrics m_chamberMetrics;
 
     PhysicsThread* m_physThread;
 
     size_t m_currentAtom = 0;
 
+    std::ofstream m_countersLog;
+    size_t m_loggedStep = 0;
+    std::ofstream m_profileLog;
+    size_t m_loggedProfileStep = 0;
+
 private slots:
     void toggleSimulation(bool);
     void setSimulationSpeed(int);
@@ -49,9 +86,19 @@ private slots:
 
     void setXLength(int);
 
+    void setPressureWindow(int);
+
     void openHole(bool);
 
+    void setPeriodic(bool);
+
+    void setContinuous(bool);
+
     void setColoring(int);
+
+    void setView(int);
+
+    void setCamera(int);
 };
 
 #endif // MAINWINDOW_H
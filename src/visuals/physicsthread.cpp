@@ -8,15 +8,28 @@ PhysicsThread::PhysicsThread(phys::Chamber& chamber, QObject* parent)
     start(LowPriority);
 }
 
-PhysicsThread::~PhysicsThread() {}
+PhysicsThread::~PhysicsThread() {
+    finish();
+}
+
+void PhysicsThread::finish() {
+    m_finished.storeRelaxed(true);
+    {
+        QMutexLocker lock(&m_mutex);
+        m_allow_run.wakeAll();
+    }
+    wait();
+}
 
 void PhysicsThread::run() {
     forever {
         {
             QMutexLocker lock(&m_mutex);
-            if (m_stopped) {
+            while (m_stopped && !m_finished.loadRelaxed()) {
                 m_allow_run.wait(&m_mutex);
             }
+            if (m_finished.loadRelaxed())
+                return;
 
             m_chamber.step();
         }
@@ -26,10 +39,14 @@ void PhysicsThread::run() {
             time = std::min(time, 5'000'000l);
             if (time < 0)
                 time = 5'000'000l;
-            usleep(time);
+            // Sleeps on the condition, finish() cuts the pause short.
+            QMutexLocker lock(&m_mutex);
+            if (!m_finished.loadRelaxed()) {
+                m_allow_run.wait(&m_mutex, static_cast<unsigned long>(time / 1000));
+            }
         } else {
             QMutexLocker lock(&m_mutex);
-            while(m_period.loadRelaxed() == -1) {
+            while(m_period.loadRelaxed() == -1 && !m_finished.loadRelaxed()) {
                 m_chamber.step();
             }
         }
@@ -46,6 +46,9 @@ public slots:
     }
 
 public:
+    /// Ends the loop after the current step and waits for the thread, the chamber is idle after it.
+    void finish();
+
     [[nodiscard]] int getPeriod() const;
     [[nodiscard]] bool getStopped();
 
@@ -54,6 +57,66 @@ public:
         m_chamber.getMetrics(metrics);
     }
 
+    void setPressureWindow(phys::Time window) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setPressureWindow(window);
+    }
+
+    void setXLength(phys::Length len) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setXLength(len);
+    }
+
+    void openHole(bool open) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.openHole(open);
+    }
+
+    void setBoundary(size_t axis, phys::Boundary boundary) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setBoundary(axis, boundary);
+    }
+
+    void setInvariantPeriod(size_t steps) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setInvariantPeriod(steps);
+    }
+
+    void setAuditPeriod(size_t steps) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setAuditPeriod(steps);
+    }
+
+    void setContinuousCollisions(bool continuous) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setContinuousCollisions(continuous);
+    }
+
+    void setMsdPeriod(size_t steps) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setMsdPeriod(steps);
+    }
+
+    void setVacfPeriod(size_t steps) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setVacfPeriod(steps);
+    }
+
+    void setRdfPeriod(size_t steps) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setRdfPeriod(steps);
+    }
+
+    void setProfilePeriod(size_t steps) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setProfilePeriod(steps);
+    }
+
+    void setThermostat(const phys::Thermostat& thermostat) {
+        QMutexLocker lock(&m_mutex);
+        m_chamber.setThermostat(thermostat);
+    }
+
 signals:
     void toggled(bool);
 
@@ -68,6 +131,7 @@ private:
     QMutex m_mutex;
     QWaitCondition m_allow_run;
     QAtomicInt m_stopped = true;
+    QAtomicInt m_finished = false;
     QAtomicInt m_period = 32;
 };
 